@@ -0,0 +1,136 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "batch.h"
+
+struct batch_limits {
+    pthread_mutex_t lock;
+    pthread_cond_t io_free;
+    pthread_cond_t memory_free;
+    int io_slots;               /* Images that may start reading */
+    uint64_t budget;
+    uint64_t reserved;
+};
+
+/* Return NULL on error */
+struct batch_limits *batch_limits_create(int io_slots, uint64_t memory_budget) {
+    struct batch_limits *limits = calloc(1, sizeof(*limits));
+    if (limits == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&limits->lock, NULL);
+    pthread_cond_init(&limits->io_free, NULL);
+    pthread_cond_init(&limits->memory_free, NULL);
+    limits->io_slots = io_slots > 0 ? io_slots : 1;
+    limits->budget = memory_budget;
+
+    return limits;
+}
+
+void batch_limits_destroy(struct batch_limits *limits) {
+    if (limits == NULL) {
+        return;
+    }
+
+    pthread_cond_destroy(&limits->memory_free);
+    pthread_cond_destroy(&limits->io_free);
+    pthread_mutex_destroy(&limits->lock);
+    free(limits);
+}
+
+void batch_begin_io(struct batch_limits *limits) {
+    pthread_mutex_lock(&limits->lock);
+    while (limits->io_slots == 0) {
+        pthread_cond_wait(&limits->io_free, &limits->lock);
+    }
+    limits->io_slots--;
+    pthread_mutex_unlock(&limits->lock);
+}
+
+void batch_end_io(struct batch_limits *limits) {
+    pthread_mutex_lock(&limits->lock);
+    limits->io_slots++;
+    pthread_cond_signal(&limits->io_free);
+    pthread_mutex_unlock(&limits->lock);
+}
+
+void batch_reserve(struct batch_limits *limits, uint64_t bytes) {
+    pthread_mutex_lock(&limits->lock);
+    while (limits->budget > 0 && limits->reserved > 0 &&
+            limits->reserved + bytes > limits->budget) {
+        pthread_cond_wait(&limits->memory_free, &limits->lock);
+    }
+    limits->reserved += bytes;
+    pthread_mutex_unlock(&limits->lock);
+}
+
+void batch_release(struct batch_limits *limits, uint64_t bytes) {
+    pthread_mutex_lock(&limits->lock);
+    limits->reserved -= bytes;
+
+    /* NOTE: Waiters need different amounts, so wake all of them */
+    pthread_cond_broadcast(&limits->memory_free);
+    pthread_mutex_unlock(&limits->lock);
+}
+
+/* Read image paths from a manifest, one per line. Empty lines are skipped.
+ *
+ * Return NULL on error
+ */
+char **batch_read_manifest(FILE *in, size_t *count) {
+    char **paths = NULL;
+    size_t n = 0;
+    size_t cap = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t len;
+
+    while ((len = getline(&line, &line_cap, in)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len == 0) {
+            continue;
+        }
+
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            char **grown = realloc(paths, cap * sizeof(char *));
+            if (grown == NULL) {
+                break;
+            }
+            paths = grown;
+        }
+        paths[n] = strdup(line);
+        if (paths[n] == NULL) {
+            break;
+        }
+        n++;
+    }
+    free(line);
+
+    /* NOTE: An empty manifest still gets a list, so NULL only means error */
+    if (paths == NULL) {
+        paths = malloc(sizeof(char *));
+    }
+    if (paths == NULL || ferror(in) || !feof(in)) {
+        batch_free_manifest(paths, n);
+        return NULL;
+    }
+
+    *count = n;
+    return paths;
+}
+
+void batch_free_manifest(char **paths, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(paths[i]);
+    }
+    free(paths);
+}
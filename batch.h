@@ -0,0 +1,34 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Limits of batch mode (--batch), shared by the images being analyzed.
+ *
+ * At most io_slots images are scanned at once. Every image reserves an
+ * estimate of the memory it needs before it is scanned and waits until the
+ * reservations of the others leave room for it within the budget. An image
+ * that does not fit even on its own still runs, but only once nothing else
+ * holds a reservation. A budget of zero means no limit.
+ */
+
+struct batch_limits;
+
+struct batch_limits *batch_limits_create(int io_slots, uint64_t memory_budget);
+void batch_limits_destroy(struct batch_limits *limits);
+
+void batch_begin_io(struct batch_limits *limits);
+void batch_end_io(struct batch_limits *limits);
+void batch_reserve(struct batch_limits *limits, uint64_t bytes);
+void batch_release(struct batch_limits *limits, uint64_t bytes);
+
+char **batch_read_manifest(FILE *in, size_t *count);
+void batch_free_manifest(char **paths, size_t count);
+
+#endif
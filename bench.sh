@@ -0,0 +1,100 @@
+#!/bin/bash
+#
+# NAME: Jesse Catalan,Ricardo Kuchimpos
+# EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+# ID: 204785152,704827423
+#
+# Benchmark lab3a against synthetic images.
+#
+#	./bench.sh [images|run] [PROFILE...]
+#
+# "images" only generates the images, "run" (the default) also scans each
+# of them $BENCH_RUNS times and reports the fastest run. Images are built
+# with mkimage into $BENCH_DIR and reused while they exist, so delete them
+# after changing a profile. Extra lab3a options go in $LAB3A_FLAGS.
+#
+# Throughput is measured against the allocated size of the image: file
+# data is never written, so the apparent size says little about the work.
+#
+
+BENCH_DIR="${BENCH_DIR:-bench-images}"
+BENCH_RUNS="${BENCH_RUNS:-3}"
+
+# Profile name and mkimage options
+PROFILES=(
+	"small		-g 64 -n 20000 -d 100 -m 40 -H 5000 -T 2"
+	"groups		-g 4096 -i 64 -n 100000 -d 1000 -m 8"
+	"inodes		-b 4096 -g 128 -n 1500000 -d 1500 -m 2 -H 500000"
+	"hugedir	-b 4096 -g 32 -n 0 -d 0 -H 1000000"
+	"deep		-g 1024 -n 0 -d 0 -T 256"
+	"frag		-g 512 -n 200000 -d 500 -m 16 -f 50"
+	"sparse		-b 4096 -g 2400 -n 20000 -d 200 -m 64 -T 4"
+)
+
+MODE="run"
+if [ "$1" == "images" -o "$1" == "run" ]; then
+	MODE="$1"
+	shift
+fi
+
+if [ ! -x ./mkimage -o \( "$MODE" == "run" -a ! -x ./lab3a \) ]; then
+	>&2 echo "FATAL: build lab3a and mkimage first (make lab3a mkimage)"
+	exit 1
+fi
+
+mkdir -p "$BENCH_DIR" || exit 1
+STATS=`mktemp`
+trap "rm -f $STATS" EXIT
+
+# scan a profile and print its report line
+#   param ... profile name
+#   param ... image path
+function scan {
+	best=""
+	for run in `seq 1 $BENCH_RUNS`; do
+		records=`./lab3a $LAB3A_FLAGS --stats=$STATS "$2" | wc -l`
+		if [ ${PIPESTATUS[0]} -ne 0 -a ${PIPESTATUS[0]} -ne 2 ]; then
+			>&2 echo "FATAL: lab3a failed on $2"
+			exit 1
+		fi
+		wall=`sed -n 's/.*"total": {"wall_ms": \([0-9.]*\).*/\1/p' $STATS`
+		rss=`sed -n 's/.*"peak_rss_kb": \([0-9]*\).*/\1/p' $STATS`
+		if [ -z "$best" ] || awk "BEGIN { exit !($wall < $best) }"; then
+			best=$wall
+			best_rss=$rss
+		fi
+	done
+
+	apparent=`stat -c %s "$2"`
+	allocated=`du -B1 "$2" | cut -f1`
+	awk -v name="$1" -v apparent=$apparent -v allocated=$allocated -v ms=$best \
+		-v records=$records -v rss=$best_rss 'BEGIN {
+		s = ms / 1000
+		if (s <= 0) s = 0.000001
+		printf "%-10s %9.2f %9.1f %9.3f %9.1f %10d %12.0f %8.1f\n", name,
+			apparent / 2^30, allocated / 2^20, s, allocated / 2^20 / s,
+			records, records / s, rss / 1024
+	}'
+}
+
+if [ "$MODE" == "run" ]; then
+	printf "%-10s %9s %9s %9s %9s %10s %12s %8s\n" profile image_GB disk_MB \
+		wall_s MB/s records records/s rss_MB
+fi
+
+for entry in "${PROFILES[@]}"; do
+	read name args <<< "$entry"
+	if [ $# -gt 0 ] && [[ ! " $* " =~ " $name " ]]; then
+		continue
+	fi
+
+	img="$BENCH_DIR/$name.img"
+	if [ ! -f "$img" ]; then
+		>&2 echo "generating $img"
+		./mkimage $args "$img.tmp" && mv "$img.tmp" "$img" || exit 1
+	fi
+
+	if [ "$MODE" == "run" ]; then
+		scan $name "$img"
+	fi
+done
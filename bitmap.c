@@ -0,0 +1,162 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <string.h>
+#include "bitmap.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_AVX2_PATH 1
+#endif
+
+/* NOTE: ext2 bitmaps store bit i in bit (i % 8) of byte (i / 8), which is
+ * exactly the bit order of a little-endian 64-bit load.
+ */
+static inline uint64_t load_word(const unsigned char *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+/* Load the 64-bit word at word_idx, reading only bytes below num_bytes */
+static inline uint64_t load_partial(const unsigned char *bitmap, uint32_t word_idx,
+        uint32_t num_bytes) {
+    uint32_t offset = word_idx * 8;
+    if (offset + 8 <= num_bytes) {
+        return load_word(bitmap + offset);
+    }
+
+    unsigned char tmp[8];
+    memset(tmp, 0xFF, sizeof(tmp));
+    memcpy(tmp, bitmap + offset, num_bytes - offset);
+    return load_word(tmp);
+}
+
+#ifdef HAVE_AVX2_PATH
+/* Skip 256-bit chunks with every bit set, starting at word_idx.
+ * Return the index of the first word that may contain a clear bit.
+ */
+__attribute__((target("avx2")))
+static uint32_t skip_allocated_avx2(const unsigned char *bitmap, uint32_t word_idx,
+        uint32_t full_words) {
+    const __m256i ones = _mm256_set1_epi32(-1);
+    while (word_idx + 4 <= full_words) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (bitmap + word_idx * 8));
+        if (!_mm256_testc_si256(v, ones)) {
+            break;
+        }
+        word_idx += 4;
+    }
+    return word_idx;
+}
+
+static int have_avx2(void) {
+    static int cached = -1;
+    if (cached == -1) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return cached;
+}
+#endif
+
+/* Scan the first num_bits bits of bitmap and report every maximal run of
+ * clear bits in increasing order. Fully allocated words are skipped without
+ * looking at individual bits, 256 bits at a time where AVX2 is available.
+ */
+void bitmap_for_each_free_run(const unsigned char *bitmap, uint32_t num_bits,
+        bitmap_run_fn fn, void *arg) {
+    uint32_t num_bytes = (num_bits + 7) / 8;
+    uint32_t num_words = (num_bits + 63) / 64;
+    uint32_t full_words = num_bytes / 8;
+    int in_run = 0;
+    uint32_t run_start = 0;
+#ifdef HAVE_AVX2_PATH
+    int use_avx2 = have_avx2();
+#endif
+
+    uint32_t w = 0;
+    while (w < num_words) {
+#ifdef HAVE_AVX2_PATH
+        if (!in_run && use_avx2) {
+            w = skip_allocated_avx2(bitmap, w, full_words);
+            if (w >= num_words) {
+                break;
+            }
+        }
+#endif
+        uint64_t word = load_partial(bitmap, w, num_bytes);
+
+        /* Treat bits past the end as allocated so runs stop there */
+        uint32_t base = w * 64;
+        if (num_bits - base < 64) {
+            word |= ~0ULL << (num_bits - base);
+        }
+
+        if (!in_run && word == ~0ULL) {
+            w++;
+            continue;
+        }
+        if (in_run && word == 0) {
+            w++;
+            continue;
+        }
+
+        /* Walk the transitions inside the word */
+        uint32_t bit = 0;
+        while (bit < 64) {
+            uint64_t rest = word >> bit;
+            if (in_run) {
+                /* Look for the next set bit, which ends the run */
+                if (rest == 0) {
+                    break;
+                }
+                uint32_t end = bit + __builtin_ctzll(rest);
+                fn(arg, run_start, base + end - run_start);
+                in_run = 0;
+                bit = end;
+            } else {
+                /* Look for the next clear bit, which starts a run */
+                uint64_t free_bits = ~rest;
+                if (free_bits == 0) {
+                    break;
+                }
+                uint32_t start = bit + __builtin_ctzll(free_bits);
+                if (start >= 64) {
+                    break;
+                }
+                run_start = base + start;
+                in_run = 1;
+                bit = start;
+            }
+        }
+        w++;
+    }
+
+    if (in_run) {
+        fn(arg, run_start, num_bits - run_start);
+    }
+}
+
+/* Count the clear bits among the first num_bits bits of bitmap */
+uint32_t bitmap_count_free(const unsigned char *bitmap, uint32_t num_bits) {
+    uint32_t num_bytes = (num_bits + 7) / 8;
+    uint32_t num_words = (num_bits + 63) / 64;
+    uint32_t count = 0;
+
+    for (uint32_t w = 0; w < num_words; w++) {
+        uint64_t word = load_partial(bitmap, w, num_bytes);
+        uint32_t base = w * 64;
+        if (num_bits - base < 64) {
+            word |= ~0ULL << (num_bits - base);
+        }
+        count += __builtin_popcountll(~word);
+    }
+
+    return count;
+}
@@ -0,0 +1,18 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stdint.h>
+
+/* Called for every run of clear (free) bits: bits [start, start + len) */
+typedef void (*bitmap_run_fn)(void *arg, uint32_t start, uint32_t len);
+
+void bitmap_for_each_free_run(const unsigned char *bitmap, uint32_t num_bits,
+        bitmap_run_fn fn, void *arg);
+uint32_t bitmap_count_free(const unsigned char *bitmap, uint32_t num_bits);
+
+#endif
@@ -0,0 +1,537 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blkhash.h"
+#include "crc32c.h"
+
+/* A data block of a file */
+struct block_hash {
+    uint32_t block;
+    uint32_t inode;
+    uint64_t lbo;
+    uint32_t crc;               /* Whole block */
+    uint32_t part;              /* Bytes of the block before the end of the file */
+};
+
+struct file_hash {
+    uint32_t inode;
+    uint32_t crc;
+    uint64_t size;
+    size_t first;               /* First of its blocks once sorted by inode */
+    size_t num_blocks;
+};
+
+/* Blocks and files recorded by one thread */
+struct hash_list {
+    struct block_hash *blocks;
+    size_t num_blocks;
+    size_t blocks_cap;
+    struct file_hash *files;
+    size_t num_files;
+    size_t files_cap;
+    int error;
+};
+
+struct blkhash {
+    struct fs *fs;
+    struct hash_list *slots;
+    int num_slots;
+};
+
+/* Create a table filled by up to num_slots threads at a time */
+struct blkhash *blkhash_create(struct fs *fs, int num_slots) {
+    struct blkhash *bh = calloc(1, sizeof(*bh));
+    if (bh == NULL) {
+        return NULL;
+    }
+    bh->fs = fs;
+    bh->slots = calloc(num_slots, sizeof(struct hash_list));
+    bh->num_slots = num_slots;
+    if (bh->slots == NULL) {
+        free(bh);
+        return NULL;
+    }
+    return bh;
+}
+
+void blkhash_destroy(struct blkhash *bh) {
+    if (bh == NULL) {
+        return;
+    }
+    for (int i = 0; i < bh->num_slots; i++) {
+        free(bh->slots[i].blocks);
+        free(bh->slots[i].files);
+    }
+    free(bh->slots);
+    free(bh);
+}
+
+/* Make room for one more element of width bytes in *array.
+ *
+ * Return 0 on success, -1 on error
+ */
+static int grow(void **array, size_t len, size_t *cap, size_t width) {
+    if (len < *cap) {
+        return 0;
+    }
+    size_t new_cap = *cap ? *cap * 2 : 1024;
+    void *p = realloc(*array, new_cap * width);
+    if (p == NULL) {
+        return -1;
+    }
+    *array = p;
+    *cap = new_cap;
+    return 0;
+}
+
+/* Record a regular file. No two threads may use the same slot at the same
+ * time.
+ */
+void blkhash_add_file(struct blkhash *bh, int slot, uint32_t inode_id, uint64_t size) {
+    struct hash_list *list = &bh->slots[slot];
+    if (grow((void **) &list->files, list->num_files, &list->files_cap,
+                sizeof(struct file_hash)) == -1) {
+        list->error = 1;
+        return;
+    }
+
+    struct file_hash *f = &list->files[list->num_files++];
+    memset(f, 0, sizeof(*f));
+    f->inode = inode_id;
+    f->size = size;
+}
+
+/* Read and hash data block lbo of a file of size bytes */
+void blkhash_add_block(struct blkhash *bh, int slot, uint32_t inode_id, uint64_t size,
+        uint32_t block_id, uint64_t lbo) {
+    struct fs *fs = bh->fs;
+    if (block_id == 0 || block_id >= fs->sb.s_blocks_count) {
+        return;
+    }
+
+    struct hash_list *list = &bh->slots[slot];
+    if (grow((void **) &list->blocks, list->num_blocks, &list->blocks_cap,
+                sizeof(struct block_hash)) == -1) {
+        list->error = 1;
+        return;
+    }
+
+    struct block_ref ref;
+    const unsigned char *data = image_get_block(fs->img, block_id, &ref);
+    if (data == NULL) {
+        return;
+    }
+
+    /* NOTE: The checksum of the part inside the file goes into the file's
+     * digest and is continued over the rest for the whole block
+     */
+    uint64_t start = lbo * fs->block_size;
+    size_t len = fs->block_size;
+    if (start >= size) {
+        len = 0;
+    } else if (size - start < len) {
+        len = size - start;
+    }
+
+    struct block_hash *b = &list->blocks[list->num_blocks++];
+    b->block = block_id;
+    b->inode = inode_id;
+    b->lbo = lbo;
+    b->part = crc32c(0, data, len);
+    b->crc = crc32c(b->part, data + len, fs->block_size - len);
+    image_put_block(fs->img, &ref);
+}
+
+/* Stable LSD radix sort of n elements of width bytes on the 32-bit key at
+ * key_offset, 16 bits per pass
+ */
+static void sort_by_key(void *base, void *tmp, size_t n, size_t width, size_t key_offset) {
+    static size_t counts[1 << 16];
+    unsigned char *src = base;
+    unsigned char *dst = tmp;
+
+    for (int shift = 0; shift < 32; shift += 16) {
+        memset(counts, 0, sizeof(counts));
+        for (size_t i = 0; i < n; i++) {
+            uint32_t key;
+            memcpy(&key, src + i * width + key_offset, sizeof(key));
+            counts[(key >> shift) & 0xFFFF]++;
+        }
+
+        size_t pos = 0;
+        for (size_t d = 0; d < (1 << 16); d++) {
+            size_t c = counts[d];
+            counts[d] = pos;
+            pos += c;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            uint32_t key;
+            memcpy(&key, src + i * width + key_offset, sizeof(key));
+            memcpy(dst + counts[(key >> shift) & 0xFFFF]++ * width, src + i * width, width);
+        }
+
+        unsigned char *swap = src;
+        src = dst;
+        dst = swap;
+    }
+}
+
+static int compare_lbo(const void *a, const void *b) {
+    const struct block_hash *x = a;
+    const struct block_hash *y = b;
+    return x->lbo < y->lbo ? -1 : x->lbo > y->lbo;
+}
+
+#define FILES_PER_JOB 1024
+
+struct digest_ctx {
+    struct blkhash *bh;
+    struct file_hash *files;
+    size_t num_files;
+    struct block_hash *blocks;
+    uint32_t block_op;          /* crc32c_combine_op of a whole block */
+};
+
+/* Join the block checksums of a file, in file order, into the checksum of
+ * its contents
+ */
+static uint32_t file_digest(struct digest_ctx *ctx, struct file_hash *f) {
+    uint64_t block_size = ctx->bh->fs->block_size;
+    struct block_hash *blocks = ctx->blocks + f->first;
+
+    /* NOTE: Blocks below a spawned subtree are recorded by another thread,
+     * so a file's blocks may come in a few sorted pieces
+     */
+    for (size_t k = 1; k < f->num_blocks; k++) {
+        if (blocks[k].lbo < blocks[k - 1].lbo) {
+            qsort(blocks, f->num_blocks, sizeof(*blocks), compare_lbo);
+            break;
+        }
+    }
+
+    uint32_t crc = 0;
+    uint64_t pos = 0;
+    for (size_t k = 0; k < f->num_blocks; k++) {
+        uint64_t start = blocks[k].lbo * block_size;
+        if (start < pos || start >= f->size) {
+            continue;
+        }
+        uint64_t len = f->size - start < block_size ? f->size - start : block_size;
+        uint32_t op = len == block_size ? ctx->block_op : crc32c_combine_op(len);
+
+        /* Holes read as zeros */
+        crc = crc32c_zeros(crc, start - pos);
+        crc = crc32c_combine(op, crc, blocks[k].part);
+        pos = start + len;
+    }
+
+    return crc32c_zeros(crc, f->size - pos);
+}
+
+static void digest_files(void *arg, size_t job) {
+    struct digest_ctx *ctx = arg;
+    size_t end = (job + 1) * FILES_PER_JOB;
+    if (end > ctx->num_files) {
+        end = ctx->num_files;
+    }
+    for (size_t i = job * FILES_PER_JOB; i < end; i++) {
+        ctx->files[i].crc = file_digest(ctx, &ctx->files[i]);
+    }
+}
+
+/* A distinct block number and the first block with the same contents */
+struct content {
+    uint32_t crc;
+    uint32_t block;
+    uint32_t rep;               /* Index of that block */
+    uint32_t copies;            /* For the first block, the size of its class */
+};
+
+#define UNRESOLVED UINT32_MAX
+#define BLOCKS_PER_JOB 4096
+
+struct verify_ctx {
+    struct fs *fs;
+    struct content *contents;
+    size_t num_contents;
+    size_t *runs;               /* First content of every run of equal checksums */
+};
+
+static int same_contents(struct fs *fs, uint32_t a, uint32_t b) {
+    struct block_ref ref_a, ref_b;
+    const void *data_a = image_get_block(fs->img, a, &ref_a);
+    if (data_a == NULL) {
+        return 0;
+    }
+    const void *data_b = image_get_block(fs->img, b, &ref_b);
+    int same = data_b && memcmp(data_a, data_b, fs->block_size) == 0;
+    if (data_b) {
+        image_put_block(fs->img, &ref_b);
+    }
+    image_put_block(fs->img, &ref_a);
+    return same;
+}
+
+/* Compare every block to the first block of its run. Runs can hold most of
+ * the image, such as the zero blocks of sparse files, so this is split by
+ * blocks rather than by runs.
+ */
+static void verify_blocks(void *arg, size_t job) {
+    struct verify_ctx *ctx = arg;
+    struct content *c = ctx->contents;
+    size_t end = (job + 1) * BLOCKS_PER_JOB;
+    if (end > ctx->num_contents) {
+        end = ctx->num_contents;
+    }
+    for (size_t k = job * BLOCKS_PER_JOB; k < end; k++) {
+        if (c[k].rep != k && !same_contents(ctx->fs, c[c[k].rep].block, c[k].block)) {
+            c[k].rep = UNRESOLVED;
+        }
+    }
+}
+
+/* Split the blocks of a run that differ from its first block into classes
+ * of blocks with the same contents, and count the blocks of every class.
+ * Such blocks are checksum collisions, so there are very few of them.
+ */
+static void verify_run(void *arg, size_t i) {
+    struct verify_ctx *ctx = arg;
+    struct content *c = ctx->contents;
+    size_t start = ctx->runs[i];
+    size_t end = ctx->runs[i + 1];
+
+    size_t num_reps = 0;
+    size_t reps_cap = 0;
+    uint32_t *reps = NULL;
+
+    for (size_t k = start; k < end; k++) {
+        if (c[k].rep == UNRESOLVED) {
+            c[k].rep = k;
+            for (size_t r = 0; r < num_reps; r++) {
+                if (same_contents(ctx->fs, c[reps[r]].block, c[k].block)) {
+                    c[k].rep = reps[r];
+                    break;
+                }
+            }
+            if (c[k].rep == k && grow((void **) &reps, num_reps, &reps_cap,
+                        sizeof(*reps)) == 0) {
+                reps[num_reps++] = k;
+            }
+        }
+        c[c[k].rep].copies++;
+    }
+
+    free(reps);
+}
+
+struct file_key {
+    uint32_t crc;
+    uint32_t inode;
+    uint64_t size;
+    size_t index;
+};
+
+static int compare_file_keys(const void *a, const void *b) {
+    const struct file_key *x = a;
+    const struct file_key *y = b;
+    if (x->crc != y->crc) {
+        return x->crc < y->crc ? -1 : 1;
+    }
+    if (x->size != y->size) {
+        return x->size < y->size ? -1 : 1;
+    }
+    return x->inode < y->inode ? -1 : x->inode > y->inode;
+}
+
+static void put_crc(struct outbuf *out, uint32_t crc) {
+    static const char digits[] = "0123456789abcdef";
+    char hex[8];
+    for (int i = 0; i < 8; i++) {
+        hex[i] = digits[(crc >> (28 - 4 * i)) & 0xF];
+    }
+    outbuf_put_mem(out, hex, sizeof(hex));
+}
+
+/* Compute the file digests and print the report. Must run after the scan
+ * has finished.
+ *
+ * Return 0 on success, -1 on error
+ */
+int blkhash_report(struct blkhash *bh, struct pool *pool, struct outbuf *out) {
+    struct fs *fs = bh->fs;
+    size_t num_blocks = 0;
+    size_t num_files = 0;
+    for (int i = 0; i < bh->num_slots; i++) {
+        if (bh->slots[i].error) {
+            return -1;
+        }
+        num_blocks += bh->slots[i].num_blocks;
+        num_files += bh->slots[i].num_files;
+    }
+
+    size_t max_width = sizeof(struct block_hash) > sizeof(struct file_hash) ?
+            sizeof(struct block_hash) : sizeof(struct file_hash);
+    size_t max_n = num_blocks > num_files ? num_blocks : num_files;
+    struct block_hash *blocks = malloc((num_blocks ? num_blocks : 1) * sizeof(*blocks));
+    struct file_hash *files = malloc((num_files ? num_files : 1) * sizeof(*files));
+    struct content *contents = malloc((num_blocks ? num_blocks : 1) * sizeof(*contents));
+    size_t *runs = malloc((num_blocks + 1) * sizeof(*runs));
+    struct file_key *keys = malloc((num_files ? num_files : 1) * sizeof(*keys));
+    uint32_t *dup_of = calloc(num_files ? num_files : 1, sizeof(*dup_of));
+    void *tmp = malloc((max_n ? max_n : 1) * max_width);
+    int rc = -1;
+    if (blocks == NULL || files == NULL || contents == NULL || runs == NULL ||
+            keys == NULL || dup_of == NULL || tmp == NULL) {
+        goto out;
+    }
+
+    size_t nb = 0;
+    size_t nf = 0;
+    for (int i = 0; i < bh->num_slots; i++) {
+        struct hash_list *list = &bh->slots[i];
+        memcpy(blocks + nb, list->blocks, list->num_blocks * sizeof(*blocks));
+        memcpy(files + nf, list->files, list->num_files * sizeof(*files));
+        nb += list->num_blocks;
+        nf += list->num_files;
+    }
+
+    /* Every file's blocks follow each other once both are in inode order */
+    sort_by_key(files, tmp, num_files, sizeof(*files), offsetof(struct file_hash, inode));
+    sort_by_key(blocks, tmp, num_blocks, sizeof(*blocks), offsetof(struct block_hash, inode));
+    size_t b = 0;
+    for (size_t i = 0; i < num_files; i++) {
+        while (b < num_blocks && blocks[b].inode < files[i].inode) {
+            b++;
+        }
+        files[i].first = b;
+        while (b < num_blocks && blocks[b].inode == files[i].inode) {
+            b++;
+        }
+        files[i].num_blocks = b - files[i].first;
+    }
+
+    struct digest_ctx digest;
+    digest.bh = bh;
+    digest.files = files;
+    digest.num_files = num_files;
+    digest.blocks = blocks;
+    digest.block_op = crc32c_combine_op(fs->block_size);
+    pool_for(pool, (num_files + FILES_PER_JOB - 1) / FILES_PER_JOB, digest_files, &digest);
+
+    /* Distinct block numbers in checksum order, then block order */
+    for (size_t i = 0; i < num_blocks; i++) {
+        contents[i].crc = blocks[i].crc;
+        contents[i].block = blocks[i].block;
+        contents[i].copies = 0;
+    }
+    sort_by_key(contents, tmp, num_blocks, sizeof(*contents), offsetof(struct content, block));
+    size_t num_contents = 0;
+    for (size_t i = 0; i < num_blocks; i++) {
+        if (num_contents == 0 || contents[num_contents - 1].block != contents[i].block) {
+            contents[num_contents++] = contents[i];
+        }
+    }
+    sort_by_key(contents, tmp, num_contents, sizeof(*contents), offsetof(struct content, crc));
+
+    size_t num_runs = 0;
+    for (size_t i = 0; i < num_contents; i++) {
+        if (i == 0 || contents[i].crc != contents[i - 1].crc) {
+            runs[num_runs++] = i;
+        }
+        contents[i].rep = runs[num_runs - 1];
+    }
+    runs[num_runs] = num_contents;
+
+    struct verify_ctx verify;
+    verify.fs = fs;
+    verify.contents = contents;
+    verify.num_contents = num_contents;
+    verify.runs = runs;
+    pool_for(pool, (num_contents + BLOCKS_PER_JOB - 1) / BLOCKS_PER_JOB, verify_blocks,
+            &verify);
+    pool_for(pool, num_runs, verify_run, &verify);
+
+    /* Files with the same checksum and size, the lowest inode first */
+    for (size_t i = 0; i < num_files; i++) {
+        keys[i].crc = files[i].crc;
+        keys[i].inode = files[i].inode;
+        keys[i].size = files[i].size;
+        keys[i].index = i;
+    }
+    qsort(keys, num_files, sizeof(*keys), compare_file_keys);
+    size_t distinct_files = 0;
+    for (size_t i = 0; i < num_files; i++) {
+        if (i > 0 && keys[i].crc == keys[i - 1].crc && keys[i].size == keys[i - 1].size) {
+            dup_of[keys[i].index] = dup_of[keys[i - 1].index] ?
+                    dup_of[keys[i - 1].index] : keys[i - 1].inode;
+        } else {
+            distinct_files++;
+        }
+    }
+
+    for (size_t i = 0; i < num_files; i++) {
+        outbuf_put_str(out, "FILEHASH,");
+        outbuf_put_u32(out, files[i].inode);
+        outbuf_put_char(out, ',');
+        outbuf_put_u64(out, files[i].size);
+        outbuf_put_char(out, ',');
+        put_crc(out, files[i].crc);
+        outbuf_put_char(out, '\n');
+    }
+
+    size_t distinct_blocks = 0;
+    for (size_t i = 0; i < num_contents; i++) {
+        if (contents[i].rep != i) {
+            continue;
+        }
+        distinct_blocks++;
+        if (contents[i].copies > 1) {
+            outbuf_put_str(out, "DUPBLOCK,");
+            put_crc(out, contents[i].crc);
+            outbuf_put_char(out, ',');
+            outbuf_put_u32(out, contents[i].copies);
+            outbuf_put_char(out, ',');
+            outbuf_put_u32(out, contents[i].block);
+            outbuf_put_char(out, '\n');
+        }
+    }
+
+    for (size_t i = 0; i < num_files; i++) {
+        if (dup_of[i]) {
+            outbuf_put_str(out, "DUPFILE,");
+            outbuf_put_u32(out, files[i].inode);
+            outbuf_put_char(out, ',');
+            outbuf_put_u32(out, dup_of[i]);
+            outbuf_put_char(out, '\n');
+        }
+    }
+
+    outbuf_put_str(out, "DEDUP,");
+    outbuf_put_u64(out, num_contents);
+    outbuf_put_char(out, ',');
+    outbuf_put_u64(out, distinct_blocks);
+    outbuf_put_char(out, ',');
+    outbuf_put_u64(out, (uint64_t) (num_contents - distinct_blocks) * fs->block_size);
+    outbuf_put_char(out, ',');
+    outbuf_put_u64(out, num_files);
+    outbuf_put_char(out, ',');
+    outbuf_put_u64(out, distinct_files);
+    outbuf_put_char(out, '\n');
+    rc = out->error ? -1 : 0;
+
+out:
+    free(blocks);
+    free(files);
+    free(contents);
+    free(runs);
+    free(keys);
+    free(dup_of);
+    free(tmp);
+    return rc;
+}
@@ -0,0 +1,42 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef BLKHASH_H
+#define BLKHASH_H
+
+#include <stdint.h>
+#include "fs.h"
+#include "pool.h"
+#include "outbuf.h"
+
+/* Content hashing of file data blocks (--hash-blocks).
+ *
+ * During the scan every data block of a regular file is read and hashed
+ * with CRC32C by the thread walking it, and recorded in a list owned by
+ * that thread. blkhash_report then joins the per-block checksums of every
+ * file into the CRC32C of its contents, holes reading as zeros, and groups
+ * blocks and files with the same contents:
+ *
+ *     FILEHASH,inode,size,crc32c
+ *     DUPBLOCK,crc32c,copies,first block
+ *     DUPFILE,inode,inode of the first file with the same contents
+ *     DEDUP,data blocks,distinct contents,bytes saved,files,distinct files
+ *
+ * Blocks with the same checksum are compared byte by byte before they are
+ * reported as duplicates. Files are duplicates when they have the same size
+ * and checksum.
+ */
+
+struct blkhash;
+
+struct blkhash *blkhash_create(struct fs *fs, int num_slots);
+void blkhash_destroy(struct blkhash *bh);
+
+void blkhash_add_file(struct blkhash *bh, int slot, uint32_t inode_id, uint64_t size);
+void blkhash_add_block(struct blkhash *bh, int slot, uint32_t inode_id, uint64_t size,
+        uint32_t block_id, uint64_t lbo);
+int blkhash_report(struct blkhash *bh, struct pool *pool, struct outbuf *out);
+
+#endif
@@ -0,0 +1,236 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "cache.h"
+
+#define CACHE_MAX_SHARDS 16
+
+struct cache_entry {
+    uint32_t block_id;
+    int valid;
+    int refcnt;
+    struct cache_entry *prev;   /* LRU list, unpinned entries only */
+    struct cache_entry *next;
+    struct cache_entry *hnext;  /* Hash chain */
+    struct cache_shard *shard;
+    unsigned char *data;
+};
+
+struct cache_shard {
+    pthread_mutex_t lock;
+    struct cache_entry **buckets;
+    size_t num_buckets;
+    struct cache_entry *lru_head;   /* Most recently used */
+    struct cache_entry *lru_tail;   /* Eviction candidate */
+    struct cache_stats stats;
+};
+
+struct block_cache {
+    int block_size;
+    cache_fill_fn fill;
+    void *fill_arg;
+    struct cache_entry *entries;
+    unsigned char *data;
+    struct cache_shard shards[CACHE_MAX_SHARDS];
+    int num_shards;
+};
+
+static void lru_unlink(struct cache_shard *shard, struct cache_entry *e) {
+    if (e->prev) {
+        e->prev->next = e->next;
+    } else {
+        shard->lru_head = e->next;
+    }
+    if (e->next) {
+        e->next->prev = e->prev;
+    } else {
+        shard->lru_tail = e->prev;
+    }
+    e->prev = e->next = NULL;
+}
+
+static void lru_push_head(struct cache_shard *shard, struct cache_entry *e) {
+    e->prev = NULL;
+    e->next = shard->lru_head;
+    if (shard->lru_head) {
+        shard->lru_head->prev = e;
+    } else {
+        shard->lru_tail = e;
+    }
+    shard->lru_head = e;
+}
+
+static void lru_push_tail(struct cache_shard *shard, struct cache_entry *e) {
+    e->next = NULL;
+    e->prev = shard->lru_tail;
+    if (shard->lru_tail) {
+        shard->lru_tail->next = e;
+    } else {
+        shard->lru_head = e;
+    }
+    shard->lru_tail = e;
+}
+
+static void hash_remove(struct cache_shard *shard, struct cache_entry *e) {
+    struct cache_entry **p = &shard->buckets[e->block_id % shard->num_buckets];
+    while (*p) {
+        if (*p == e) {
+            *p = e->hnext;
+            break;
+        }
+        p = &(*p)->hnext;
+    }
+    e->hnext = NULL;
+}
+
+/* Create a cache holding up to num_blocks blocks.
+ *
+ * Return NULL on error
+ */
+struct block_cache *cache_create(size_t num_blocks, int block_size,
+        cache_fill_fn fill, void *fill_arg) {
+    if (num_blocks == 0) {
+        return NULL;
+    }
+
+    struct block_cache *cache = calloc(1, sizeof(*cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->block_size = block_size;
+    cache->fill = fill;
+    cache->fill_arg = fill_arg;
+    cache->entries = calloc(num_blocks, sizeof(struct cache_entry));
+    cache->data = malloc(num_blocks * block_size);
+    if (cache->entries == NULL || cache->data == NULL) {
+        free(cache->entries);
+        free(cache->data);
+        free(cache);
+        return NULL;
+    }
+
+    cache->num_shards = num_blocks < CACHE_MAX_SHARDS ? num_blocks : CACHE_MAX_SHARDS;
+    for (int s = 0; s < cache->num_shards; s++) {
+        struct cache_shard *shard = &cache->shards[s];
+        pthread_mutex_init(&shard->lock, NULL);
+        shard->num_buckets = 2 * (num_blocks / cache->num_shards) + 1;
+        shard->buckets = calloc(shard->num_buckets, sizeof(struct cache_entry *));
+    }
+
+    /* Deal the entries out to the shards; all of them start unused */
+    for (size_t i = 0; i < num_blocks; i++) {
+        struct cache_entry *e = &cache->entries[i];
+        e->shard = &cache->shards[i % cache->num_shards];
+        e->data = cache->data + i * block_size;
+        lru_push_tail(e->shard, e);
+    }
+
+    return cache;
+}
+
+void cache_destroy(struct block_cache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    for (int s = 0; s < cache->num_shards; s++) {
+        pthread_mutex_destroy(&cache->shards[s].lock);
+        free(cache->shards[s].buckets);
+    }
+    free(cache->entries);
+    free(cache->data);
+    free(cache);
+}
+
+/* Get a pinned copy of block_id, reading it on a miss.
+ *
+ * Return NULL if every entry of the shard is pinned or the read failed;
+ * the caller should then read the block itself.
+ */
+const void *cache_get(struct block_cache *cache, uint32_t block_id,
+        struct cache_entry **entry) {
+    struct cache_shard *shard = &cache->shards[block_id % cache->num_shards];
+    struct cache_entry *e;
+
+    *entry = NULL;
+    pthread_mutex_lock(&shard->lock);
+
+    for (e = shard->buckets[block_id % shard->num_buckets]; e; e = e->hnext) {
+        if (e->block_id == block_id && e->valid) {
+            if (e->refcnt++ == 0) {
+                lru_unlink(shard, e);
+            }
+            shard->stats.hits++;
+            pthread_mutex_unlock(&shard->lock);
+            *entry = e;
+            return e->data;
+        }
+    }
+
+    shard->stats.misses++;
+
+    e = shard->lru_tail;
+    if (e == NULL) {
+        pthread_mutex_unlock(&shard->lock);
+        return NULL;
+    }
+
+    lru_unlink(shard, e);
+    if (e->valid) {
+        hash_remove(shard, e);
+        e->valid = 0;
+        shard->stats.evictions++;
+    }
+
+    /* NOTE: The block is read with the shard locked so that concurrent
+     * misses on the same block never read it twice.
+     */
+    if (cache->fill(cache->fill_arg, block_id, e->data) == -1) {
+        lru_push_tail(shard, e);
+        pthread_mutex_unlock(&shard->lock);
+        return NULL;
+    }
+
+    e->block_id = block_id;
+    e->valid = 1;
+    e->refcnt = 1;
+    size_t bucket = block_id % shard->num_buckets;
+    e->hnext = shard->buckets[bucket];
+    shard->buckets[bucket] = e;
+
+    pthread_mutex_unlock(&shard->lock);
+    *entry = e;
+    return e->data;
+}
+
+void cache_put(struct block_cache *cache, struct cache_entry *entry) {
+    (void) cache;
+    struct cache_shard *shard = entry->shard;
+
+    pthread_mutex_lock(&shard->lock);
+    if (--entry->refcnt == 0) {
+        lru_push_head(shard, entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void cache_get_stats(struct block_cache *cache, struct cache_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (cache == NULL) {
+        return;
+    }
+
+    for (int s = 0; s < cache->num_shards; s++) {
+        struct cache_shard *shard = &cache->shards[s];
+        pthread_mutex_lock(&shard->lock);
+        stats->hits += shard->stats.hits;
+        stats->misses += shard->stats.misses;
+        stats->evictions += shard->stats.evictions;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
@@ -0,0 +1,43 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Fixed-budget LRU cache of image blocks keyed by block number.
+ *
+ * Entries handed out by cache_get are pinned until cache_put and are never
+ * evicted while pinned. The cache is split into shards with their own lock
+ * so that group workers rarely contend.
+ */
+
+#define CACHE_DEFAULT_BLOCKS 2048
+
+struct block_cache;
+struct cache_entry;
+
+/* Fill buf with block_id. Return 0 on success, -1 on error */
+typedef int (*cache_fill_fn)(void *arg, uint32_t block_id, void *buf);
+
+struct cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+struct block_cache *cache_create(size_t num_blocks, int block_size,
+        cache_fill_fn fill, void *fill_arg);
+void cache_destroy(struct block_cache *cache);
+
+const void *cache_get(struct block_cache *cache, uint32_t block_id,
+        struct cache_entry **entry);
+void cache_put(struct block_cache *cache, struct cache_entry *entry);
+
+void cache_get_stats(struct block_cache *cache, struct cache_stats *stats);
+
+#endif
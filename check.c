@@ -0,0 +1,710 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "check.h"
+
+struct dotdot_entry {
+    uint32_t dir_id;
+    uint32_t entry_id;
+};
+
+/* '..' entries recorded by one thread. They can only be checked once every
+ * directory has been scanned and all parents are known.
+ */
+struct dotdot_list {
+    struct dotdot_entry *entries;
+    size_t len;
+    size_t cap;
+};
+
+struct check {
+    struct fs *fs;
+
+    /* Indexed by inode number - 1 */
+    _Atomic uint64_t *inode_allocated;  /* Bitmap of inodes in use */
+    _Atomic uint64_t *inode_is_dir;     /* Bitmap of directory inodes */
+    uint16_t *link_counts;              /* i_links_count of each inode */
+    _Atomic uint32_t *links;            /* Directory entries referring to each inode */
+    _Atomic uint32_t *parents;          /* Directory holding each directory */
+
+    /* Indexed by block number */
+    uint64_t *block_reserved;           /* File system metadata */
+    _Atomic uint64_t *block_referenced;
+    _Atomic uint64_t *block_duplicate;
+    atomic_int have_duplicates;
+
+    struct dotdot_list *dotdots;        /* One list per slot */
+    int num_slots;
+
+    /* Filled in by check_finish */
+    struct dotdot_entry *sorted_dotdots;
+    size_t *dotdot_offsets;             /* First '..' entry of each group */
+    atomic_size_t problems;
+};
+
+static const char *const block_kinds[] = {
+    "BLOCK",
+    "INDIRECT BLOCK",
+    "DOUBLE INDIRECT BLOCK",
+    "TRIPLE INDIRECT BLOCK"
+};
+
+/* NOTE: Bitmaps get one spare word so that load_bits can always read the
+ * word after the one holding its first bit
+ */
+static inline size_t bitmap_words(uint64_t num_bits) {
+    return num_bits / 64 + 2;
+}
+
+static inline int test_bit(const uint64_t *bitmap, uint64_t bit) {
+    return (bitmap[bit / 64] >> (bit % 64)) & 1;
+}
+
+static inline int test_bit_atomic(_Atomic uint64_t *bitmap, uint64_t bit) {
+    uint64_t word = atomic_load_explicit(&bitmap[bit / 64], memory_order_relaxed);
+    return (word >> (bit % 64)) & 1;
+}
+
+/* Set a bit and return its previous value */
+static inline int set_bit_atomic(_Atomic uint64_t *bitmap, uint64_t bit) {
+    uint64_t mask = (uint64_t) 1 << (bit % 64);
+    return (atomic_fetch_or_explicit(&bitmap[bit / 64], mask, memory_order_relaxed) & mask) != 0;
+}
+
+/* Return the 64 bits starting at bit */
+static inline uint64_t load_bits(const uint64_t *bitmap, uint64_t bit) {
+    size_t word = bit / 64;
+    int shift = bit % 64;
+
+    if (shift == 0) {
+        return bitmap[word];
+    }
+    return (bitmap[word] >> shift) | (bitmap[word + 1] << (64 - shift));
+}
+
+/* Return the 64 bits of an on-disk bitmap starting at bit, which must be a
+ * multiple of 64. Bits past num_bits read as zero.
+ */
+static inline uint64_t load_disk_bits(const unsigned char *bitmap, uint32_t bit,
+        uint32_t num_bits) {
+    uint64_t word = 0;
+    uint32_t num_bytes = (num_bits - bit + 7) / 8;
+    if (num_bytes > 8) {
+        num_bytes = 8;
+    }
+    for (uint32_t i = 0; i < num_bytes; i++) {
+        word |= (uint64_t) bitmap[bit / 8 + i] << (8 * i);
+    }
+    return word;
+}
+
+static void mark_reserved(struct check *check, uint64_t first, uint64_t count) {
+    uint64_t end = first + count;
+    if (end > check->fs->sb.s_blocks_count) {
+        end = check->fs->sb.s_blocks_count;
+    }
+    for (uint64_t b = first; b < end; b++) {
+        check->block_reserved[b / 64] |= (uint64_t) 1 << (b % 64);
+    }
+}
+
+static int is_power_of(uint32_t n, uint32_t base) {
+    while (n > 1 && n % base == 0) {
+        n /= base;
+    }
+    return n == 1;
+}
+
+/* NOTE: With sparse_super only groups 0, 1 and powers of 3, 5 and 7 carry a
+ * backup of the superblock and the group descriptor table
+ */
+static int group_has_super(struct fs *fs, uint32_t group) {
+    if (!(fs->sb.s_feature_ro_compat & EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER) || group <= 1) {
+        return 1;
+    }
+    return is_power_of(group, 3) || is_power_of(group, 5) || is_power_of(group, 7);
+}
+
+/* Mark the superblock, group descriptor table, bitmaps and inode table of
+ * every group as reserved. File blocks may never point at them.
+ */
+static void mark_metadata(struct check *check) {
+    struct fs *fs = check->fs;
+    size_t table_size = (size_t) fs->num_groups * sizeof(struct ext2_group_desc);
+    uint32_t table_blocks = (table_size + fs->block_size - 1) / fs->block_size;
+
+    /* Everything before the superblock (the boot block) belongs with it */
+    mark_reserved(check, 0, fs->sb.s_first_data_block);
+
+    for (uint32_t g = 0; g < fs->num_groups; g++) {
+        struct ext2_group_desc *grp = &fs->groups[g];
+        if (group_has_super(fs, g)) {
+            mark_reserved(check, fs_group_first_block(fs, g), 1 + table_blocks);
+        }
+        mark_reserved(check, grp->bg_block_bitmap, 1);
+        mark_reserved(check, grp->bg_inode_bitmap, 1);
+        mark_reserved(check, grp->bg_inode_table, fs_inode_table_blocks(fs));
+    }
+}
+
+/* Create a checker fed by up to num_slots threads at a time */
+struct check *check_create(struct fs *fs, int num_slots) {
+    struct check *check = calloc(1, sizeof(*check));
+    if (check == NULL) {
+        return NULL;
+    }
+    check->fs = fs;
+
+    uint32_t num_inodes = fs->sb.s_inodes_count;
+    uint32_t num_blocks = fs->sb.s_blocks_count;
+    check->inode_allocated = calloc(bitmap_words(num_inodes), sizeof(uint64_t));
+    check->inode_is_dir = calloc(bitmap_words(num_inodes), sizeof(uint64_t));
+    check->link_counts = calloc(num_inodes, sizeof(uint16_t));
+    check->links = calloc(num_inodes, sizeof(uint32_t));
+    check->parents = calloc(num_inodes, sizeof(uint32_t));
+    check->block_reserved = calloc(bitmap_words(num_blocks), sizeof(uint64_t));
+    check->block_referenced = calloc(bitmap_words(num_blocks), sizeof(uint64_t));
+    check->block_duplicate = calloc(bitmap_words(num_blocks), sizeof(uint64_t));
+    check->dotdots = calloc(num_slots, sizeof(struct dotdot_list));
+    check->num_slots = num_slots;
+
+    if (check->inode_allocated == NULL || check->inode_is_dir == NULL ||
+            check->link_counts == NULL || check->links == NULL || check->parents == NULL ||
+            check->block_reserved == NULL || check->block_referenced == NULL ||
+            check->block_duplicate == NULL || check->dotdots == NULL) {
+        check_destroy(check);
+        return NULL;
+    }
+
+    mark_metadata(check);
+
+    return check;
+}
+
+void check_destroy(struct check *check) {
+    if (check == NULL) {
+        return;
+    }
+
+    if (check->dotdots) {
+        for (int i = 0; i < check->num_slots; i++) {
+            free(check->dotdots[i].entries);
+        }
+    }
+    free(check->dotdots);
+    free(check->sorted_dotdots);
+    free(check->dotdot_offsets);
+    free(check->inode_allocated);
+    free(check->inode_is_dir);
+    free(check->link_counts);
+    free(check->links);
+    free(check->parents);
+    free(check->block_reserved);
+    free(check->block_referenced);
+    free(check->block_duplicate);
+    free(check);
+}
+
+static void scan_group_inodes(void *arg, size_t group) {
+    struct check *check = arg;
+    struct inode_iter it;
+    if (inode_iter_init(&it, check->fs, group) == -1) {
+        return;
+    }
+
+    const struct ext2_inode *inode_entry;
+    uint32_t inode_id;
+    while ((inode_entry = inode_iter_next(&it, &inode_id)) != NULL) {
+        if (inode_entry->i_mode == 0 || inode_entry->i_links_count == 0) {
+            continue;
+        }
+
+        /* NOTE: Inode tables of neighbouring groups may share a bitmap word */
+        set_bit_atomic(check->inode_allocated, inode_id - 1);
+        if (S_ISDIR(inode_entry->i_mode)) {
+            set_bit_atomic(check->inode_is_dir, inode_id - 1);
+        }
+        check->link_counts[inode_id - 1] = inode_entry->i_links_count;
+    }
+
+    inode_iter_done(&it);
+}
+
+/* Record which inodes are allocated. Must run before the main traversal. */
+void check_scan_inodes(struct check *check, struct pool *pool) {
+    pool_for(pool, check->fs->num_groups, scan_group_inodes, check);
+}
+
+static void report_block(struct check *check, struct outbuf *out, const char *problem,
+        uint32_t block_id, uint32_t inode_id, uint64_t lbo, int level) {
+    outbuf_put_str(out, problem);
+    outbuf_put_char(out, ' ');
+    outbuf_put_str(out, block_kinds[level]);
+    outbuf_put_char(out, ' ');
+    outbuf_put_u32(out, block_id);
+    outbuf_put_str(out, " IN INODE ");
+    outbuf_put_u32(out, inode_id);
+    outbuf_put_str(out, " AT OFFSET ");
+    outbuf_put_u64(out, lbo);
+    outbuf_put_char(out, '\n');
+    atomic_fetch_add_explicit(&check->problems, 1, memory_order_relaxed);
+}
+
+static int block_valid(struct check *check, uint32_t block_id) {
+    return block_id >= check->fs->sb.s_first_data_block &&
+            block_id < check->fs->sb.s_blocks_count &&
+            !test_bit(check->block_reserved, block_id);
+}
+
+/* Record a reference from an inode to a block. level is the level of
+ * indirection of the referenced block, 0 for data blocks.
+ *
+ * Return 1 if the block may be read, 0 if it is invalid or reserved
+ */
+int check_block(struct check *check, struct outbuf *out, uint32_t block_id,
+        uint32_t inode_id, uint64_t lbo, int level) {
+    struct fs *fs = check->fs;
+
+    if (block_id < fs->sb.s_first_data_block || block_id >= fs->sb.s_blocks_count) {
+        report_block(check, out, "INVALID", block_id, inode_id, lbo, level);
+        return 0;
+    }
+    if (test_bit(check->block_reserved, block_id)) {
+        report_block(check, out, "RESERVED", block_id, inode_id, lbo, level);
+        return 0;
+    }
+
+    /* NOTE: Every reference to a duplicate block has to be reported, so the
+     * owners of the earlier references are found again in check_finish
+     */
+    if (set_bit_atomic(check->block_referenced, block_id)) {
+        set_bit_atomic(check->block_duplicate, block_id);
+        atomic_store_explicit(&check->have_duplicates, 1, memory_order_relaxed);
+    }
+
+    return 1;
+}
+
+static void report_dirent(struct check *check, struct outbuf *out, uint32_t dir_id,
+        const char *name, int name_len) {
+    outbuf_put_str(out, "DIRECTORY INODE ");
+    outbuf_put_u32(out, dir_id);
+    outbuf_put_str(out, " NAME '");
+    outbuf_put_mem(out, name, name_len);
+    outbuf_put_str(out, "' ");
+    atomic_fetch_add_explicit(&check->problems, 1, memory_order_relaxed);
+}
+
+static void report_link(struct check *check, struct outbuf *out, uint32_t dir_id,
+        const char *name, uint32_t entry_id, uint32_t expected_id) {
+    report_dirent(check, out, dir_id, name, strlen(name));
+    outbuf_put_str(out, "LINK TO INODE ");
+    outbuf_put_u32(out, entry_id);
+    outbuf_put_str(out, " SHOULD BE ");
+    outbuf_put_u32(out, expected_id);
+    outbuf_put_char(out, '\n');
+}
+
+static void add_dotdot(struct dotdot_list *list, uint32_t dir_id, uint32_t entry_id) {
+    if (list->len == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 64;
+        struct dotdot_entry *entries = realloc(list->entries, cap * sizeof(*entries));
+        if (entries == NULL) {
+            return;
+        }
+        list->entries = entries;
+        list->cap = cap;
+    }
+    list->entries[list->len].dir_id = dir_id;
+    list->entries[list->len].entry_id = entry_id;
+    list->len++;
+}
+
+/* Record a directory entry. No two threads may use the same slot at the
+ * same time.
+ */
+void check_dirent(struct check *check, int slot, struct outbuf *out, uint32_t dir_id,
+        uint32_t entry_id, const char *name, int name_len) {
+    struct fs *fs = check->fs;
+    int is_dot = name_len == 1 && name[0] == '.';
+    int is_dotdot = name_len == 2 && name[0] == '.' && name[1] == '.';
+
+    if (entry_id < 1 || entry_id > fs->sb.s_inodes_count) {
+        report_dirent(check, out, dir_id, name, name_len);
+        outbuf_put_str(out, "INVALID INODE ");
+        outbuf_put_u32(out, entry_id);
+        outbuf_put_char(out, '\n');
+        return;
+    }
+    if (!test_bit_atomic(check->inode_allocated, entry_id - 1)) {
+        report_dirent(check, out, dir_id, name, name_len);
+        outbuf_put_str(out, "UNALLOCATED INODE ");
+        outbuf_put_u32(out, entry_id);
+        outbuf_put_char(out, '\n');
+        return;
+    }
+
+    atomic_fetch_add_explicit(&check->links[entry_id - 1], 1, memory_order_relaxed);
+
+    if (is_dot) {
+        if (entry_id != dir_id) {
+            report_link(check, out, dir_id, ".", entry_id, dir_id);
+        }
+    } else if (is_dotdot) {
+        add_dotdot(&check->dotdots[slot], dir_id, entry_id);
+    } else if (test_bit_atomic(check->inode_is_dir, entry_id - 1)) {
+        atomic_store_explicit(&check->parents[entry_id - 1], dir_id, memory_order_relaxed);
+    }
+}
+
+/* Output streams of a group in check_finish, written out one after the
+ * other like the record streams of the main traversal
+ */
+enum check_stream {
+    CHECK_DUPLICATE,
+    CHECK_BLOCK_BITMAP,
+    CHECK_INODE_BITMAP,
+    CHECK_DOTDOT,
+    CHECK_LINKS,
+    NUM_CHECK_STREAMS
+};
+
+struct finish_ctx {
+    struct check *check;
+    struct outbuf *bufs;    /* NUM_CHECK_STREAMS buffers per group */
+};
+
+/* Walk the block tree below a reference again and report every reference
+ * to a block that is referenced more than once
+ */
+static void report_duplicates(struct check *check, struct outbuf *out, uint32_t inode_id,
+        uint32_t block_id, uint64_t lbo, int level) {
+    struct fs *fs = check->fs;
+
+    if (block_id == 0 || !block_valid(check, block_id)) {
+        return;
+    }
+    if (test_bit_atomic(check->block_duplicate, block_id)) {
+        report_block(check, out, "DUPLICATE", block_id, inode_id, lbo, level);
+    }
+    if (level == 0) {
+        return;
+    }
+
+    uint64_t span = 1;
+    for (int l = 1; l < level; l++) {
+        span *= fs->ptrs_per_block;
+    }
+
+    struct block_ref ref;
+    const __u32 *ptr = image_get_block(fs->img, block_id, &ref);
+    if (ptr == NULL) {
+        return;
+    }
+    for (int i = 0; i < fs->ptrs_per_block; i++) {
+        report_duplicates(check, out, inode_id, ptr[i], lbo + i * span, level - 1);
+    }
+    image_put_block(fs->img, &ref);
+}
+
+static void find_group_duplicates(struct check *check, struct outbuf *out, uint32_t group) {
+    struct fs *fs = check->fs;
+    struct inode_iter it;
+    if (inode_iter_init(&it, fs, group) == -1) {
+        return;
+    }
+
+    const struct ext2_inode *inode_entry;
+    uint32_t inode_id;
+    while ((inode_entry = inode_iter_next(&it, &inode_id)) != NULL) {
+        if (!fs_inode_has_blocks(inode_entry)) {
+            continue;
+        }
+
+        for (int k = 0; k < EXT2_NDIR_BLOCKS; k++) {
+            report_duplicates(check, out, inode_id, inode_entry->i_block[k], k, 0);
+        }
+
+        uint64_t lbo = EXT2_NDIR_BLOCKS;
+        uint64_t span = fs->ptrs_per_block;
+        for (int level = 1; level <= 3; level++) {
+            report_duplicates(check, out, inode_id,
+                    inode_entry->i_block[EXT2_NDIR_BLOCKS + level - 1], lbo, level);
+            lbo += span;
+            span *= fs->ptrs_per_block;
+        }
+    }
+
+    inode_iter_done(&it);
+}
+
+/* Compare the block bitmap of a group with the blocks actually referenced:
+ * UNREFERENCED BLOCK 37
+ * ALLOCATED BLOCK 8 ON FREELIST
+ */
+static void check_block_bitmap(struct check *check, struct outbuf *out, uint32_t group) {
+    struct fs *fs = check->fs;
+    struct block_ref ref;
+    const unsigned char *bitmap = image_get_block(fs->img, fs->groups[group].bg_block_bitmap, &ref);
+    if (bitmap == NULL) {
+        return;
+    }
+
+    uint32_t first_block = fs_group_first_block(fs, group);
+    uint32_t num_bits = fs_group_bitmap_blocks(fs, group);
+    const uint64_t *referenced = (const uint64_t *) check->block_referenced;
+
+    for (uint32_t bit = 0; bit < num_bits; bit += 64) {
+        uint64_t in_use = load_disk_bits(bitmap, bit, num_bits);
+        uint64_t refs = load_bits(referenced, first_block + bit);
+        uint64_t reserved = load_bits(check->block_reserved, first_block + bit);
+        uint64_t valid = num_bits - bit >= 64 ? ~(uint64_t) 0 :
+                ((uint64_t) 1 << (num_bits - bit)) - 1;
+
+        uint64_t problems = (in_use ^ refs) & ~reserved & valid;
+        while (problems) {
+            int i = __builtin_ctzll(problems);
+            problems &= problems - 1;
+
+            uint32_t block_id = first_block + bit + i;
+            if ((refs >> i) & 1) {
+                outbuf_put_str(out, "ALLOCATED BLOCK ");
+                outbuf_put_u32(out, block_id);
+                outbuf_put_str(out, " ON FREELIST\n");
+            } else {
+                outbuf_put_str(out, "UNREFERENCED BLOCK ");
+                outbuf_put_u32(out, block_id);
+                outbuf_put_char(out, '\n');
+            }
+            atomic_fetch_add_explicit(&check->problems, 1, memory_order_relaxed);
+        }
+    }
+
+    image_put_block(fs->img, &ref);
+}
+
+/* Compare the inode bitmap of a group with the inode table:
+ * ALLOCATED INODE 2 ON FREELIST
+ * UNALLOCATED INODE 17 NOT ON FREELIST
+ *
+ * NOTE: Reserved inodes below s_first_ino are marked in use without being
+ * allocated, so they are never reported as missing from the free list
+ */
+static void check_inode_bitmap(struct check *check, struct outbuf *out, uint32_t group) {
+    struct fs *fs = check->fs;
+    struct block_ref ref;
+    const unsigned char *bitmap = image_get_block(fs->img, fs->groups[group].bg_inode_bitmap, &ref);
+    if (bitmap == NULL) {
+        return;
+    }
+
+    uint32_t first_inode = fs_group_first_inode(fs, group);
+    uint32_t num_bits = fs_group_inodes(fs, group);
+    if (num_bits > (uint32_t) fs->block_size * 8) {
+        num_bits = fs->block_size * 8;
+    }
+    const uint64_t *allocated = (const uint64_t *) check->inode_allocated;
+
+    for (uint32_t bit = 0; bit < num_bits; bit += 64) {
+        uint64_t in_use = load_disk_bits(bitmap, bit, num_bits);
+        uint64_t alloc = load_bits(allocated, first_inode - 1 + bit);
+        uint64_t valid = num_bits - bit >= 64 ? ~(uint64_t) 0 :
+                ((uint64_t) 1 << (num_bits - bit)) - 1;
+
+        uint64_t problems = (in_use ^ alloc) & valid;
+        while (problems) {
+            int i = __builtin_ctzll(problems);
+            problems &= problems - 1;
+
+            uint32_t inode_id = first_inode + bit + i;
+            if ((alloc >> i) & 1) {
+                outbuf_put_str(out, "ALLOCATED INODE ");
+                outbuf_put_u32(out, inode_id);
+                outbuf_put_str(out, " ON FREELIST\n");
+            } else if (inode_id >= fs->sb.s_first_ino) {
+                outbuf_put_str(out, "UNALLOCATED INODE ");
+                outbuf_put_u32(out, inode_id);
+                outbuf_put_str(out, " NOT ON FREELIST\n");
+            } else {
+                continue;
+            }
+            atomic_fetch_add_explicit(&check->problems, 1, memory_order_relaxed);
+        }
+    }
+
+    image_put_block(fs->img, &ref);
+}
+
+/* DIRECTORY INODE 12 NAME '..' LINK TO INODE 11 SHOULD BE 2 */
+static void check_dotdots(struct check *check, struct outbuf *out, uint32_t group) {
+    for (size_t i = check->dotdot_offsets[group]; i < check->dotdot_offsets[group + 1]; i++) {
+        uint32_t dir_id = check->sorted_dotdots[i].dir_id;
+        uint32_t entry_id = check->sorted_dotdots[i].entry_id;
+        uint32_t parent_id = dir_id == EXT2_ROOT_INO ? EXT2_ROOT_INO : check->parents[dir_id - 1];
+
+        /* NOTE: A parent of 0 means no directory refers to this one; that is
+         * reported through its link count instead
+         */
+        if (parent_id != 0 && entry_id != parent_id) {
+            report_link(check, out, dir_id, "..", entry_id, parent_id);
+        }
+    }
+}
+
+/* INODE 2 HAS 4 LINKS BUT LINKCOUNT IS 3
+ *
+ * NOTE: Reserved inodes other than the root (the resize inode, the journal)
+ * have no directory entries
+ */
+static void check_links(struct check *check, struct outbuf *out, uint32_t group) {
+    struct fs *fs = check->fs;
+    uint32_t first_inode = fs_group_first_inode(fs, group);
+    uint32_t num_inodes = fs_group_inodes(fs, group);
+
+    for (uint32_t i = first_inode - 1; i < first_inode - 1 + num_inodes; i++) {
+        if (!test_bit_atomic(check->inode_allocated, i) || check->links[i] == check->link_counts[i]) {
+            continue;
+        }
+        if (i + 1 < fs->sb.s_first_ino && i + 1 != EXT2_ROOT_INO) {
+            continue;
+        }
+        outbuf_put_str(out, "INODE ");
+        outbuf_put_u32(out, i + 1);
+        outbuf_put_str(out, " HAS ");
+        outbuf_put_u32(out, check->links[i]);
+        outbuf_put_str(out, " LINKS BUT LINKCOUNT IS ");
+        outbuf_put_u32(out, check->link_counts[i]);
+        outbuf_put_char(out, '\n');
+        atomic_fetch_add_explicit(&check->problems, 1, memory_order_relaxed);
+    }
+}
+
+static void finish_group(void *arg, size_t group) {
+    struct finish_ctx *ctx = arg;
+    struct check *check = ctx->check;
+    struct outbuf *outs = &ctx->bufs[group * NUM_CHECK_STREAMS];
+
+    for (int s = 0; s < NUM_CHECK_STREAMS; s++) {
+        outbuf_init(&outs[s], -1, 0);
+    }
+
+    if (atomic_load(&check->have_duplicates)) {
+        find_group_duplicates(check, &outs[CHECK_DUPLICATE], group);
+    }
+    check_block_bitmap(check, &outs[CHECK_BLOCK_BITMAP], group);
+    check_inode_bitmap(check, &outs[CHECK_INODE_BITMAP], group);
+    check_dotdots(check, &outs[CHECK_DOTDOT], group);
+    check_links(check, &outs[CHECK_LINKS], group);
+}
+
+static int compare_dotdots(const void *a, const void *b) {
+    const struct dotdot_entry *x = a;
+    const struct dotdot_entry *y = b;
+
+    if (x->dir_id != y->dir_id) {
+        return x->dir_id < y->dir_id ? -1 : 1;
+    }
+    if (x->entry_id != y->entry_id) {
+        return x->entry_id < y->entry_id ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Join the per-slot '..' lists in directory order and split them by group.
+ *
+ * Return 0 on success, -1 on error
+ */
+static int sort_dotdots(struct check *check) {
+    struct fs *fs = check->fs;
+
+    size_t n = 0;
+    for (int i = 0; i < check->num_slots; i++) {
+        n += check->dotdots[i].len;
+    }
+
+    check->sorted_dotdots = malloc((n ? n : 1) * sizeof(struct dotdot_entry));
+    check->dotdot_offsets = malloc((fs->num_groups + 1) * sizeof(size_t));
+    if (check->sorted_dotdots == NULL || check->dotdot_offsets == NULL) {
+        return -1;
+    }
+
+    size_t pos = 0;
+    for (int i = 0; i < check->num_slots; i++) {
+        struct dotdot_list *list = &check->dotdots[i];
+        if (list->len > 0) {
+            memcpy(check->sorted_dotdots + pos, list->entries,
+                    list->len * sizeof(struct dotdot_entry));
+            pos += list->len;
+        }
+    }
+    qsort(check->sorted_dotdots, n, sizeof(struct dotdot_entry), compare_dotdots);
+
+    size_t first = 0;
+    for (uint32_t g = 0; g < fs->num_groups; g++) {
+        uint64_t end_id = (uint64_t) fs_group_first_inode(fs, g) + fs->sb.s_inodes_per_group;
+        check->dotdot_offsets[g] = first;
+        while (first < n && check->sorted_dotdots[first].dir_id < end_id) {
+            first++;
+        }
+    }
+    check->dotdot_offsets[fs->num_groups] = n;
+
+    return 0;
+}
+
+/* Run the checks that need the whole traversal to have finished and write
+ * their reports to out.
+ *
+ * Return 1 if any inconsistency was found, 0 if none was, -1 on error
+ */
+int check_finish(struct check *check, struct pool *pool, struct outbuf *out) {
+    struct fs *fs = check->fs;
+    size_t num_bufs = (size_t) fs->num_groups * NUM_CHECK_STREAMS;
+
+    if (sort_dotdots(check) == -1) {
+        return -1;
+    }
+
+    struct finish_ctx ctx;
+    ctx.check = check;
+    ctx.bufs = calloc(num_bufs, sizeof(struct outbuf));
+    struct outbuf **order = calloc(num_bufs, sizeof(struct outbuf *));
+    if (ctx.bufs == NULL || order == NULL) {
+        free(ctx.bufs);
+        free(order);
+        return -1;
+    }
+
+    pool_for(pool, fs->num_groups, finish_group, &ctx);
+
+    size_t n = 0;
+    for (int s = 0; s < NUM_CHECK_STREAMS; s++) {
+        for (uint32_t g = 0; g < fs->num_groups; g++) {
+            order[n++] = &ctx.bufs[(size_t) g * NUM_CHECK_STREAMS + s];
+        }
+    }
+
+    int rc = 0;
+    outbuf_flush(out);
+    if (outbuf_writev(out->fd, order, n) == -1) {
+        out->error = 1;
+        rc = -1;
+    }
+
+    for (size_t i = 0; i < num_bufs; i++) {
+        outbuf_free(&ctx.bufs[i]);
+    }
+    free(order);
+    free(ctx.bufs);
+
+    if (rc == 0 && atomic_load(&check->problems) > 0) {
+        rc = 1;
+    }
+    return rc;
+}
@@ -0,0 +1,43 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdint.h>
+#include "fs.h"
+#include "pool.h"
+#include "outbuf.h"
+
+/* In-memory consistency checker (--check).
+ *
+ * check_scan_inodes records which inodes are allocated before the main
+ * traversal starts. The traversal then reports every block reference of an
+ * inode with fs_inode_has_blocks set through check_block and every
+ * directory entry through check_dirent. Block references are tracked in
+ * bitmaps and link counts in per-inode counters, all updated atomically so
+ * groups can be scanned in parallel. check_finish compares the result
+ * against the free bitmaps and the inode link counts.
+ *
+ * Reports use the messages of the lab3b checker, e.g.
+ * DUPLICATE BLOCK 29 IN INODE 16 AT OFFSET 0
+ * INODE 2 HAS 4 LINKS BUT LINKCOUNT IS 3
+ */
+
+struct check;
+
+struct check *check_create(struct fs *fs, int num_slots);
+void check_destroy(struct check *check);
+
+void check_scan_inodes(struct check *check, struct pool *pool);
+
+int check_block(struct check *check, struct outbuf *out, uint32_t block_id,
+        uint32_t inode_id, uint64_t lbo, int level);
+void check_dirent(struct check *check, int slot, struct outbuf *out, uint32_t dir_id,
+        uint32_t entry_id, const char *name, int name_len);
+
+int check_finish(struct check *check, struct pool *pool, struct outbuf *out);
+
+#endif
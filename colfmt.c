@@ -0,0 +1,172 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "colfmt.h"
+
+static const char zeros[COLFMT_ALIGN];
+
+static inline uint64_t align_up(uint64_t n) {
+    return (n + COLFMT_ALIGN - 1) & ~(uint64_t) (COLFMT_ALIGN - 1);
+}
+
+static uint64_t source_size(const struct colfmt_source *col) {
+    uint64_t size = 0;
+    for (size_t i = 0; i < col->num_bufs; i++) {
+        size += col->bufs[i]->len;
+    }
+    return size;
+}
+
+/* Number of rows held by a column */
+uint64_t colfmt_rows(const struct colfmt_source *col) {
+    if (col->type == COLFMT_OFFSETS) {
+        return source_size(col) / sizeof(uint32_t);
+    }
+    return source_size(col) / ((uint64_t) col->width * col->count);
+}
+
+/* Turn string lengths into num_rows + 1 offsets */
+static int build_offsets(const struct colfmt_source *col, struct outbuf *out) {
+    uint64_t offset = 0;
+    outbuf_put_mem(out, &offset, sizeof(offset));
+    for (size_t i = 0; i < col->num_bufs; i++) {
+        const uint32_t *lens = (const void *) col->bufs[i]->buf;
+        size_t n = col->bufs[i]->len / sizeof(uint32_t);
+        for (size_t k = 0; k < n; k++) {
+            offset += lens[k];
+            outbuf_put_mem(out, &offset, sizeof(offset));
+        }
+    }
+    return out->error ? -1 : 0;
+}
+
+/* Write the columns to fd with writev, straight from their buffers.
+ *
+ * Return 0 on success, -1 on error
+ */
+int colfmt_write(int fd, const struct colfmt_source *cols, size_t num_cols) {
+    struct colfmt_table *tables = calloc(num_cols, sizeof(*tables));
+    struct colfmt_column *columns = calloc(num_cols, sizeof(*columns));
+    struct outbuf *offsets = calloc(num_cols, sizeof(*offsets));
+    struct outbuf *pads = calloc(num_cols + 1, sizeof(*pads));
+    const struct colfmt_source **written = calloc(num_cols, sizeof(*written));
+    int rc = -1;
+    if (tables == NULL || columns == NULL || offsets == NULL || pads == NULL ||
+            written == NULL) {
+        goto out;
+    }
+    for (size_t c = 0; c < num_cols; c++) {
+        outbuf_init(&offsets[c], -1, 0);
+    }
+
+    /* Lay out the tables that have rows */
+    uint32_t num_tables = 0;
+    uint32_t num_columns = 0;
+    size_t c = 0;
+    while (c < num_cols) {
+        size_t end = c + 1;
+        while (end < num_cols && strcmp(cols[end].table, cols[c].table) == 0) {
+            end++;
+        }
+
+        uint64_t num_rows = colfmt_rows(&cols[c]);
+        if (num_rows > 0) {
+            struct colfmt_table *t = &tables[num_tables++];
+            strncpy(t->name, cols[c].table, sizeof(t->name) - 1);
+            t->num_rows = num_rows;
+            t->first_column = num_columns;
+            t->num_columns = end - c;
+
+            for (size_t k = c; k < end; k++) {
+                struct colfmt_column *col = &columns[num_columns];
+                strncpy(col->name, cols[k].name, sizeof(col->name) - 1);
+                col->type = cols[k].type;
+                col->width = cols[k].width;
+                col->count = cols[k].count;
+                if (cols[k].type == COLFMT_OFFSETS) {
+                    if (build_offsets(&cols[k], &offsets[num_columns]) == -1) {
+                        goto out;
+                    }
+                    col->size = offsets[num_columns].len;
+                } else {
+                    col->size = source_size(&cols[k]);
+                }
+                written[num_columns++] = &cols[k];
+            }
+        }
+        c = end;
+    }
+
+    struct colfmt_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COLFMT_MAGIC, sizeof(header.magic));
+    header.version = COLFMT_VERSION;
+    header.num_tables = num_tables;
+    header.num_columns = num_columns;
+
+    uint64_t meta_size = sizeof(header) + num_tables * sizeof(struct colfmt_table) +
+            num_columns * sizeof(struct colfmt_column);
+    uint64_t pos = align_up(meta_size);
+    for (uint32_t k = 0; k < num_columns; k++) {
+        columns[k].offset = pos;
+        pos = align_up(pos + columns[k].size);
+    }
+    header.file_size = pos;
+
+    struct outbuf meta;
+    outbuf_init(&meta, -1, 0);
+    outbuf_put_mem(&meta, &header, sizeof(header));
+    outbuf_put_mem(&meta, tables, num_tables * sizeof(struct colfmt_table));
+    outbuf_put_mem(&meta, columns, num_columns * sizeof(struct colfmt_column));
+
+    /* NOTE: Every piece is followed by the zero padding up to the next
+     * aligned offset
+     */
+    size_t num_parts = 2;
+    for (uint32_t k = 0; k < num_columns; k++) {
+        num_parts += written[k]->num_bufs + 2;
+    }
+    struct outbuf **parts = malloc(num_parts * sizeof(*parts));
+    if (parts == NULL || meta.error) {
+        free(parts);
+        outbuf_free(&meta);
+        goto out;
+    }
+
+    size_t n = 0;
+    parts[n++] = &meta;
+    pads[0].buf = (char *) zeros;
+    pads[0].len = align_up(meta_size) - meta_size;
+    parts[n++] = &pads[0];
+    for (uint32_t k = 0; k < num_columns; k++) {
+        if (columns[k].type == COLFMT_OFFSETS) {
+            parts[n++] = &offsets[k];
+        } else {
+            for (size_t i = 0; i < written[k]->num_bufs; i++) {
+                parts[n++] = written[k]->bufs[i];
+            }
+        }
+        pads[k + 1].buf = (char *) zeros;
+        pads[k + 1].len = align_up(columns[k].size) - columns[k].size;
+        parts[n++] = &pads[k + 1];
+    }
+
+    rc = outbuf_writev(fd, parts, n);
+    free(parts);
+    outbuf_free(&meta);
+
+out:
+    for (size_t k = 0; offsets && k < num_cols; k++) {
+        outbuf_free(&offsets[k]);
+    }
+    free(tables);
+    free(columns);
+    free(offsets);
+    free(pads);
+    free(written);
+    return rc;
+}
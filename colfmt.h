@@ -0,0 +1,82 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef COLFMT_H
+#define COLFMT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "outbuf.h"
+
+/* Binary columnar output (--format=binary).
+ *
+ * The file is a header, a table directory, a column directory and then the
+ * data of every column. A table holds one record type (INODE, DIRENT, ...)
+ * and its columns follow each other in the column directory. Each column is
+ * a packed array of fixed-width little-endian values, count values per
+ * row, starting on a COLFMT_ALIGN byte boundary so it can be mapped and
+ * read with aligned vector loads.
+ *
+ * Strings live in a heap column of raw bytes. The offsets column before it
+ * holds num_rows + 1 64-bit offsets into the heap: the string of row i
+ * spans [offset[i], offset[i + 1]).
+ */
+
+#define COLFMT_MAGIC "EXT2COLS"
+#define COLFMT_VERSION 1
+#define COLFMT_ALIGN 64
+
+/* Column types */
+#define COLFMT_UINT 1           /* Unsigned integers of width bytes */
+#define COLFMT_CHAR 2           /* Single ASCII characters */
+#define COLFMT_OFFSETS 3        /* Offsets into the following heap column */
+#define COLFMT_HEAP 4           /* String bytes */
+
+struct colfmt_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_tables;
+    uint32_t num_columns;
+    uint32_t reserved;
+    uint64_t file_size;
+};
+
+struct colfmt_table {
+    char name[16];
+    uint64_t num_rows;
+    uint32_t first_column;
+    uint32_t num_columns;
+};
+
+struct colfmt_column {
+    char name[32];
+    uint32_t type;
+    uint32_t width;             /* Bytes per value */
+    uint32_t count;             /* Values per row */
+    uint32_t reserved;
+    uint64_t offset;            /* From the start of the file */
+    uint64_t size;              /* In bytes */
+};
+
+/* A column to write. Consecutive columns with the same table name form a
+ * table; the first column of a table gives its number of rows, and tables
+ * without rows are left out. The data is the concatenation of bufs. For
+ * COLFMT_OFFSETS columns the buffers hold the 32-bit length of every
+ * string instead, which are turned into offsets while writing.
+ */
+struct colfmt_source {
+    const char *table;
+    const char *name;
+    uint32_t type;
+    uint32_t width;
+    uint32_t count;
+    struct outbuf **bufs;
+    size_t num_bufs;
+};
+
+uint64_t colfmt_rows(const struct colfmt_source *col);
+int colfmt_write(int fd, const struct colfmt_source *cols, size_t num_cols);
+
+#endif
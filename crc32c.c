@@ -0,0 +1,156 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include "crc32c.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_SSE42_PATH 1
+#endif
+
+/* Bit-reflected Castagnoli polynomial */
+#define CRC32C_POLY 0x82f63b78
+
+static uint32_t tables[8][256];
+static uint32_t x2n_table[32];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+/* Multiply a and b modulo the polynomial. Bit 31 is x^0, bit 0 is x^31. */
+static uint32_t multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = 1U << 31;
+    uint32_t p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+static void init_tables(void) {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t crc = n;
+        for (int k = 0; k < 8; k++) {
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        tables[0][n] = crc;
+    }
+    for (uint32_t n = 0; n < 256; n++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t prev = tables[t - 1][n];
+            tables[t][n] = (prev >> 8) ^ tables[0][prev & 0xFF];
+        }
+    }
+
+    /* NOTE: x2n_table[k] is x^(2^k) modulo the polynomial */
+    uint32_t p = 1U << 30;
+    for (int k = 0; k < 32; k++) {
+        x2n_table[k] = p;
+        p = multmodp(p, p);
+    }
+}
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t len) {
+    while (len > 0 && ((uintptr_t) p & 7) != 0) {
+        crc = (crc >> 8) ^ tables[0][(crc ^ *p++) & 0xFF];
+        len--;
+    }
+    while (len >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, sizeof(lo));
+        memcpy(&hi, p + 4, sizeof(hi));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = tables[7][lo & 0xFF] ^ tables[6][(lo >> 8) & 0xFF] ^
+                tables[5][(lo >> 16) & 0xFF] ^ tables[4][lo >> 24] ^
+                tables[3][hi & 0xFF] ^ tables[2][(hi >> 8) & 0xFF] ^
+                tables[1][(hi >> 16) & 0xFF] ^ tables[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = (crc >> 8) ^ tables[0][(crc ^ *p++) & 0xFF];
+        len--;
+    }
+    return crc;
+}
+
+#ifdef HAVE_SSE42_PATH
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len) {
+    uint64_t crc64 = crc;
+    while (len > 0 && ((uintptr_t) p & 7) != 0) {
+        crc64 = _mm_crc32_u8(crc64, *p++);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc64 = _mm_crc32_u8(crc64, *p++);
+        len--;
+    }
+    return crc64;
+}
+
+static int have_sse42(void) {
+    static int cached = -1;
+    if (cached == -1) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+    }
+    return cached;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+    crc = ~crc;
+#ifdef HAVE_SSE42_PATH
+    if (have_sse42()) {
+        return ~crc32c_hw(crc, buf, len);
+    }
+#endif
+    pthread_once(&tables_once, init_tables);
+    return ~crc32c_sw(crc, buf, len);
+}
+
+/* Operator appending len2 bytes to a checksum, for crc32c_combine */
+uint32_t crc32c_combine_op(uint64_t len2) {
+    pthread_once(&tables_once, init_tables);
+
+    /* NOTE: Appending a byte multiplies by x^8, so start at x^(2^3) */
+    uint32_t p = 1U << 31;
+    for (int k = 3; len2 != 0; len2 >>= 1, k++) {
+        if (len2 & 1) {
+            p = multmodp(x2n_table[k & 31], p);
+        }
+    }
+    return p;
+}
+
+uint32_t crc32c_combine(uint32_t op, uint32_t crc1, uint32_t crc2) {
+    return multmodp(op, crc1) ^ crc2;
+}
+
+/* NOTE: Zero bytes only shift the register, so appending len of them is
+ * the same multiplication as for combining, on the uninverted checksum
+ */
+uint32_t crc32c_zeros(uint32_t crc, uint64_t len) {
+    return ~multmodp(crc32c_combine_op(len), ~crc);
+}
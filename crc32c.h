@@ -0,0 +1,32 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC32C (Castagnoli), with the SSE4.2 crc32 instruction where available
+ * and slicing-by-8 tables otherwise.
+ *
+ * crc32c(0, buf, len) is the checksum of buf; passing the checksum of a
+ * previous piece continues it. The checksums of two pieces hashed apart
+ * can be joined without their data:
+ *
+ *     op = crc32c_combine_op(len2);
+ *     crc32c(crc32c(0, a, len1), b, len2) == crc32c_combine(op, crc1, crc2)
+ *
+ * The operator only depends on len2, so it is computed once for pieces of
+ * the same length such as whole blocks. crc32c_zeros extends a checksum
+ * by len zero bytes, also without touching them.
+ */
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+uint32_t crc32c_combine_op(uint64_t len2);
+uint32_t crc32c_combine(uint32_t op, uint32_t crc1, uint32_t crc2);
+uint32_t crc32c_zeros(uint32_t crc, uint64_t len);
+
+#endif
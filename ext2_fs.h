@@ -17,6 +17,9 @@
  *  Simplified for OS project use by Mark Kampe
  */
 
+#ifndef _LINUX_EXT2_FS_H
+#define _LINUX_EXT2_FS_H
+
 /* types normally from linux/types.h	*/
 typedef __uint32_t	__u32;
 typedef __uint16_t	__u16;
@@ -98,7 +101,7 @@ struct ext2_inode {
 	__u32	i_block[EXT2_N_BLOCKS];/* Pointers to blocks */
 	__u32	i_version;	/* File version (for NFS) */
 	__u32	i_file_acl;	/* File ACL */
-	__u32	i_dir_acl;	/* Directory ACL */
+	__u32	i_dir_acl;	/* Directory ACL / high 32 bits of file size */
 	__u32	i_faddr;	/* Fragment address */
 	__u8	i_frag;		/* Fragment number */
 	__u8	i_fsize;	/* Fragment size */
@@ -106,6 +109,13 @@ struct ext2_inode {
 	__u32	i_reserved2[2];
 };
 
+#define i_size_high	i_dir_acl
+
+/*
+ * Inode flags
+ */
+#define EXT2_INDEX_FL			0x00001000 /* hash-indexed directory */
+
 /*
  * File system states
  */
@@ -163,9 +173,54 @@ struct ext2_super_block {
 	__u32	s_feature_compat; 	/* compatible feature set */
 	__u32	s_feature_incompat; 	/* incompatible feature set */
 	__u32	s_feature_ro_compat; 	/* readonly-compatible feature set */
-	__u32	s_reserved[230];	/* Padding to the end of the block */
+	__u8	s_uuid[16];		/* 128-bit uuid for volume */
+	char	s_volume_name[16]; 	/* volume name */
+	char	s_last_mounted[64]; 	/* directory where last mounted */
+	__u32	s_algorithm_usage_bitmap; /* For compression */
+	/*
+	 * Performance hints.  Directory preallocation should only
+	 * happen if the EXT2_COMPAT_PREALLOC flag is on.
+	 */
+	__u8	s_prealloc_blocks;	/* Nr of blocks to try to preallocate*/
+	__u8	s_prealloc_dir_blocks;	/* Nr to preallocate for dirs */
+	__u16	s_reserved_gdt_blocks;	/* Per group table for online growth */
+	/*
+	 * Journaling support valid if EXT3_FEATURE_COMPAT_HAS_JOURNAL set.
+	 */
+	__u8	s_journal_uuid[16];	/* uuid of journal superblock */
+	__u32	s_journal_inum;		/* inode number of journal file */
+	__u32	s_journal_dev;		/* device number of journal file */
+	__u32	s_last_orphan;		/* start of list of inodes to delete */
+	__u32	s_hash_seed[4];		/* HTREE hash seed */
+	__u8	s_def_hash_version;	/* Default hash version to use */
+	__u8	s_jnl_backup_type; 	/* Default type of journal backup */
+	__u16	s_desc_size;		/* Group desc. size: INCOMPAT_64BIT */
+	__u32	s_default_mount_opts;
+	__u32	s_first_meta_bg;	/* First metablock group */
+	__u32	s_mkfs_time;		/* When the filesystem was created */
+	__u32	s_jnl_blocks[17]; 	/* Backup of the journal inode */
+	__u32	s_blocks_count_hi;	/* Blocks count high 32bits */
+	__u32	s_r_blocks_count_hi;	/* Reserved blocks count high 32 bits*/
+	__u32	s_free_blocks_hi; 	/* Free blocks count */
+	__u16	s_min_extra_isize;	/* All inodes have at least # bytes */
+	__u16	s_want_extra_isize; 	/* New inodes should reserve # bytes */
+	__u32	s_flags;		/* Miscellaneous flags */
+	__u32	s_reserved[167];	/* Padding to the end of the block */
 };
 
+/*
+ * Superblock flags
+ */
+#define EXT2_FLAGS_SIGNED_HASH		0x0001  /* Signed dirhash in use */
+#define EXT2_FLAGS_UNSIGNED_HASH	0x0002  /* Unsigned dirhash in use */
+
+/*
+ * Feature set definitions
+ */
+#define EXT2_FEATURE_COMPAT_DIR_INDEX		0x0020
+#define EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER	0x0001
+#define EXT2_FEATURE_RO_COMPAT_LARGE_FILE	0x0002
+
 /*
  * Structure of a directory entry
  */
@@ -178,3 +233,37 @@ struct ext2_dir_entry {
 	__u8	file_type;		/* file type */
 	char	name[EXT2_NAME_LEN];	/* File name */
 };
+
+/*
+ * Hashed (htree) directory index. Block 0 of an indexed directory holds the
+ * "." and ".." entries, the latter spanning the rest of the block, followed
+ * by the root info and the root's index entries. Interior index blocks
+ * start with a fake empty entry spanning the whole block.
+ */
+#define DX_HASH_LEGACY		0
+#define DX_HASH_HALF_MD4	1
+#define DX_HASH_TEA		2
+#define DX_HASH_LEGACY_UNSIGNED	3
+#define DX_HASH_HALF_MD4_UNSIGNED	4
+#define DX_HASH_TEA_UNSIGNED	5
+
+struct dx_root_info {
+	__u32	reserved_zero;
+	__u8	hash_version;
+	__u8	info_length;		/* 8 */
+	__u8	indirect_levels;
+	__u8	unused_flags;
+};
+
+/* The first index entry of a node keeps limit and count in its hash */
+struct dx_countlimit {
+	__u16	limit;
+	__u16	count;
+};
+
+struct dx_entry {
+	__u32	hash;
+	__u32	block;			/* Logical block in the directory */
+};
+
+#endif
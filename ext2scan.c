@@ -0,0 +1,532 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "ext2scan.h"
+#include "scheduler.h"
+#include "prefetch.h"
+#include "bitmap.h"
+
+struct ext2scan {
+    struct fs *fs;
+    struct pool *pool;
+    struct prefetch *prefetch;      /* Read-ahead of indirect and directory blocks */
+};
+
+/* State of the block walk of a single inode */
+struct inode_walk {
+    struct ext2scan_ctx ctx;
+    const struct ext2scan_visitor *visitor;
+    struct sched *sched;        /* NULL to walk on the calling thread only */
+    struct fs *fs;
+    struct prefetch *prefetch;
+    int is_dir;
+};
+
+/* Queued part of a block walk */
+struct walk_task {
+    struct inode_walk walk;
+    int level;                  /* 0 for a whole inode */
+    uint32_t block_id;
+    uint64_t lbo;
+    __u32 i_block[EXT2_N_BLOCKS];
+};
+
+struct ext2scan *ext2scan_create(struct fs *fs, struct pool *pool) {
+    struct ext2scan *scan = calloc(1, sizeof(*scan));
+    if (scan == NULL) {
+        return NULL;
+    }
+    scan->fs = fs;
+    scan->pool = pool;
+    return scan;
+}
+
+void ext2scan_destroy(struct ext2scan *scan) {
+    if (scan == NULL) {
+        return;
+    }
+    prefetch_destroy(scan->prefetch);
+    free(scan);
+}
+
+/* Read ahead up to depth indirect and directory blocks per worker, or
+ * turn read-ahead off with a depth of 0.
+ *
+ * Return 0 on success, -1 on error
+ */
+int ext2scan_set_prefetch(struct ext2scan *scan, int depth) {
+    prefetch_destroy(scan->prefetch);
+    scan->prefetch = NULL;
+    if (depth > 0) {
+        scan->prefetch = prefetch_create(scan->fs->img, pool_size(scan->pool), depth);
+        if (scan->prefetch == NULL) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Report the superblock and then every group descriptor, in order, on the
+ * calling thread
+ */
+void ext2scan_summary(struct ext2scan *scan, const struct ext2scan_visitor *visitor) {
+    struct fs *fs = scan->fs;
+
+    if (visitor->superblock) {
+        visitor->superblock(visitor->arg, &fs->sb);
+    }
+    if (visitor->group) {
+        for (uint32_t g = 0; g < fs->num_groups; g++) {
+            visitor->group(visitor->arg, g, &fs->groups[g]);
+        }
+    }
+}
+
+/* Hand off the rest of a walk to the scheduler. The task starts with a
+ * copy of the walk in its own strand. Return NULL if the walk has to carry
+ * on by itself.
+ */
+static struct walk_task *new_walk_task(struct inode_walk *walk) {
+    struct walk_task *task = malloc(sizeof(*task));
+    if (task == NULL) {
+        return NULL;
+    }
+    task->walk = *walk;
+    if (walk->visitor->split) {
+        task->walk.ctx.strand = walk->visitor->split(&walk->ctx);
+    }
+    return task;
+}
+
+/* Iterate through the directory entries of a data block.
+ *
+ * NOTE: Blocks of hashed (htree) directories need no special handling. The
+ * index root lives past the name of the ".." entry of block 0, and every
+ * interior index block starts with an unused entry spanning the whole
+ * block, so index data is never taken for entries.
+ */
+static void scan_dir(struct inode_walk *walk, const char *block, uint64_t lbo) {
+    int block_size = walk->fs->block_size;
+
+    int size = 0;
+    while (size <= block_size - 8) {
+        const struct ext2_dir_entry *dirent = (const void *) (block + size);
+        int rec_len = dirent->rec_len;
+
+        /* NOTE: A record can never be shorter than its 8 byte header */
+        if (rec_len < 8 || rec_len > block_size - size) {
+            break;
+        }
+
+        if (dirent->inode != 0) {
+            int name_len = dirent->name_len;
+            if (name_len > rec_len - 8) {
+                name_len = rec_len - 8;
+            }
+            walk->visitor->dirent(&walk->ctx, size + lbo * block_size, dirent, name_len);
+        }
+
+        size += rec_len;
+    }
+}
+
+/* Directory blocks that follow each other both on disk and in the file.
+ * Freshly written directories are mostly made of such runs, which are
+ * then fetched with a single read instead of one per block.
+ */
+#define DIR_RUN_MAX_BLOCKS 64
+
+struct dir_run {
+    uint32_t block_id;
+    uint64_t lbo;
+    size_t len;
+};
+
+static void scan_dir_run(struct inode_walk *walk, struct dir_run *run) {
+    struct image *img = walk->fs->img;
+    int block_size = walk->fs->block_size;
+
+    if (run->len == 0) {
+        return;
+    }
+
+    struct block_ref ref;
+    const char *blocks = image_get_blocks(img, run->block_id, run->len, &ref);
+    if (blocks != NULL) {
+        for (size_t i = 0; i < run->len; i++) {
+            scan_dir(walk, blocks + i * block_size, run->lbo + i);
+        }
+        image_put_blocks(img, &ref);
+    } else {
+        /* NOTE: The run may cross the end of a truncated image */
+        for (size_t i = 0; i < run->len; i++) {
+            const char *block = image_get_block(img, run->block_id + i, &ref);
+            if (block == NULL) {
+                break;
+            }
+            scan_dir(walk, block, run->lbo + i);
+            image_put_block(img, &ref);
+        }
+    }
+
+    run->len = 0;
+}
+
+/* Queue a directory block for scanning, extending the current run if
+ * possible
+ */
+static void add_dir_block(struct inode_walk *walk, struct dir_run *run, uint32_t block_id,
+        uint64_t lbo) {
+    if (run->len > 0 && run->len < DIR_RUN_MAX_BLOCKS &&
+            block_id == run->block_id + run->len && lbo == run->lbo + run->len) {
+        run->len++;
+        return;
+    }
+
+    scan_dir_run(walk, run);
+    run->block_id = block_id;
+    run->lbo = lbo;
+    run->len = 1;
+}
+
+/* Report a block reference of the inode being walked.
+ *
+ * Return 1 if the block may be read, 0 if the visitor rejected it
+ */
+static inline int visit_ref(struct inode_walk *walk, uint32_t block_id, uint64_t lbo,
+        int level) {
+    if (walk->visitor->block == NULL) {
+        return 1;
+    }
+    return walk->visitor->block(&walk->ctx, block_id, lbo, level);
+}
+
+static void run_walk_task(struct sched *sched, int worker, void *arg);
+
+/* Visit an indirect block. Each block of the tree is read exactly once:
+ * its references are reported and, for directories, the data blocks it
+ * points to are scanned for entries.
+ *
+ * The subtrees below a double or triple indirect block are handed to the
+ * scheduler, so idle workers can steal parts of a large file.
+ */
+static void visit_indirect(struct inode_walk *walk, int level, uint32_t block_id,
+        uint64_t lbo) {
+    struct fs *fs = walk->fs;
+    int num_entries = fs->ptrs_per_block;
+    int spawn = level > 1 && walk->sched && sched_workers(walk->sched) > 1;
+
+    /* Number of data blocks covered by each reference of this block */
+    uint64_t span = 1;
+    for (int l = 1; l < level; l++) {
+        span *= num_entries;
+    }
+
+    struct block_ref ref;
+    const __u32 *ptr = image_get_block(fs->img, block_id, &ref);
+    if (ptr == NULL) {
+        return;
+    }
+
+    /* NOTE: Only blocks that will be read are worth fetching; the data
+     * blocks of regular files are never touched
+     */
+    if (walk->prefetch && (level > 1 || walk->is_dir)) {
+        prefetch_blocks(walk->prefetch, walk->ctx.worker, ptr, num_entries);
+    }
+
+    struct dir_run run;
+    run.len = 0;
+
+    for (int i = 0; i < num_entries; i++) {
+        if (ptr[i] == 0) {
+            continue;
+        }
+
+        uint64_t ref_lbo = lbo + i * span;
+        if (!visit_ref(walk, ptr[i], ref_lbo, level - 1)) {
+            continue;
+        }
+        if (walk->visitor->indirect) {
+            walk->visitor->indirect(&walk->ctx, level, ref_lbo, block_id, ptr[i]);
+        }
+
+        struct walk_task *task = spawn ? new_walk_task(walk) : NULL;
+        if (task) {
+            task->level = level - 1;
+            task->block_id = ptr[i];
+            task->lbo = ref_lbo;
+            sched_spawn(walk->sched, walk->ctx.worker, run_walk_task, task);
+        } else if (level > 1) {
+            visit_indirect(walk, level - 1, ptr[i], ref_lbo);
+        } else if (walk->is_dir) {
+            add_dir_block(walk, &run, ptr[i], ref_lbo);
+        }
+    }
+    scan_dir_run(walk, &run);
+
+    image_put_block(fs->img, &ref);
+}
+
+/* Walk the direct and indirect blocks of an inode */
+static void walk_blocks(struct inode_walk *walk, const __u32 *i_block) {
+    struct dir_run run;
+    run.len = 0;
+
+    for (int k = 0; k < EXT2_NDIR_BLOCKS; k++) {
+        uint32_t block_id = i_block[k];
+        if (block_id == 0) {
+            continue;
+        }
+        if (!visit_ref(walk, block_id, k, 0)) {
+            continue;
+        }
+        if (walk->is_dir) {
+            add_dir_block(walk, &run, block_id, k);
+        }
+    }
+    scan_dir_run(walk, &run);
+
+    /* Scan indirect, double indirect and triple indirect blocks */
+    int num_entries = walk->fs->ptrs_per_block;
+    uint64_t lbo = EXT2_NDIR_BLOCKS;
+    uint64_t span = num_entries;
+    for (int level = 1; level <= 3; level++) {
+        uint32_t block_id = i_block[EXT2_NDIR_BLOCKS + level - 1];
+        if (block_id != 0 && visit_ref(walk, block_id, lbo, level)) {
+            visit_indirect(walk, level, block_id, lbo);
+        }
+        lbo += span;
+        span *= num_entries;
+    }
+}
+
+static void run_walk_task(struct sched *sched, int worker, void *arg) {
+    struct walk_task *task = arg;
+    struct inode_walk *walk = &task->walk;
+
+    (void) sched;
+    walk->ctx.worker = worker;
+    if (task->level == 0) {
+        walk_blocks(walk, task->i_block);
+    } else {
+        visit_indirect(walk, task->level, task->block_id, task->lbo);
+    }
+    free(task);
+}
+
+/* Visit one inode of the inode table. Inodes with indirect blocks are
+ * walked by a separate task.
+ */
+static void visit_inode(struct inode_walk *walk, uint32_t inode_id,
+        const struct ext2_inode *inode_entry) {
+    const struct ext2scan_visitor *visitor = walk->visitor;
+
+    walk->ctx.inode_id = inode_id;
+    walk->ctx.size = inode_entry->i_size;
+    if (S_ISREG(inode_entry->i_mode)) {
+        walk->ctx.size |= (uint64_t) inode_entry->i_size_high << 32;
+    }
+    int flags;
+    if (visitor->inode) {
+        flags = visitor->inode(&walk->ctx, inode_id, inode_entry);
+    } else {
+        flags = fs_inode_has_blocks(inode_entry) ?
+                EXT2SCAN_WALK_BLOCKS | EXT2SCAN_READ_DIRS : 0;
+    }
+    if (!(flags & EXT2SCAN_WALK_BLOCKS)) {
+        return;
+    }
+
+    walk->ctx.flags = flags;
+    walk->is_dir = S_ISDIR(inode_entry->i_mode) && (flags & EXT2SCAN_READ_DIRS) &&
+            visitor->dirent;
+
+    if (walk->prefetch) {
+        const __u32 *blocks = inode_entry->i_block;
+        size_t n = EXT2_N_BLOCKS;
+        if (!walk->is_dir) {
+            blocks += EXT2_NDIR_BLOCKS;
+            n -= EXT2_NDIR_BLOCKS;
+        }
+        prefetch_blocks(walk->prefetch, walk->ctx.worker, blocks, n);
+    }
+
+    int indirect = inode_entry->i_block[EXT2_IND_BLOCK] ||
+            inode_entry->i_block[EXT2_DIND_BLOCK] || inode_entry->i_block[EXT2_TIND_BLOCK];
+    if (indirect && walk->sched && sched_workers(walk->sched) > 1) {
+        struct walk_task *task = new_walk_task(walk);
+        if (task) {
+            task->level = 0;
+            memcpy(task->i_block, inode_entry->i_block, sizeof(task->i_block));
+            sched_spawn(walk->sched, walk->ctx.worker, run_walk_task, task);
+            return;
+        }
+    }
+
+    walk_blocks(walk, inode_entry->i_block);
+}
+
+struct free_run_ctx {
+    struct ext2scan_ctx *ctx;
+    void (*fn)(struct ext2scan_ctx *ctx, uint32_t first, uint32_t count);
+    uint32_t first_id;      /* Object represented by bit 0 */
+};
+
+static void visit_free_run(void *arg, uint32_t start, uint32_t len) {
+    struct free_run_ctx *run = arg;
+    run->fn(run->ctx, run->first_id + start, len);
+}
+
+static void scan_bitmap(struct inode_walk *walk,
+        void (*fn)(struct ext2scan_ctx *ctx, uint32_t first, uint32_t count),
+        uint32_t bitmap_block, uint32_t first_id, uint32_t num_bits) {
+    struct block_ref ref;
+    const unsigned char *bitmap = image_get_block(walk->fs->img, bitmap_block, &ref);
+    if (bitmap == NULL) {
+        return;
+    }
+
+    struct free_run_ctx run;
+    run.ctx = &walk->ctx;
+    run.fn = fn;
+    run.first_id = first_id;
+    bitmap_for_each_free_run(bitmap, num_bits, visit_free_run, &run);
+
+    image_put_block(walk->fs->img, &ref);
+}
+
+static void scan_free_runs(struct inode_walk *walk, uint32_t group) {
+    const struct ext2scan_visitor *visitor = walk->visitor;
+    struct fs *fs = walk->fs;
+
+    if (visitor->free_blocks) {
+        scan_bitmap(walk, visitor->free_blocks, fs->groups[group].bg_block_bitmap,
+                fs_group_first_block(fs, group), fs_group_bitmap_blocks(fs, group));
+    }
+
+    if (visitor->free_inodes) {
+        uint32_t num_bits = fs_group_inodes(fs, group);
+        if (num_bits > (uint32_t) fs->block_size * 8) {
+            num_bits = fs->block_size * 8;
+        }
+        scan_bitmap(walk, visitor->free_inodes, fs->groups[group].bg_inode_bitmap,
+                fs_group_first_inode(fs, group), num_bits);
+    }
+}
+
+/* Scan a whole group: its bitmaps and every inode of its inode table */
+static void scan_group(struct inode_walk *walk, uint32_t group) {
+    scan_free_runs(walk, group);
+
+    struct inode_iter it;
+    if (inode_iter_init(&it, walk->fs, group) == -1) {
+        return;
+    }
+
+    const struct ext2_inode *inode_entry;
+    uint32_t inode_id;
+    while ((inode_entry = inode_iter_next(&it, &inode_id)) != NULL) {
+        visit_inode(walk, inode_id, inode_entry);
+    }
+
+    inode_iter_done(&it);
+}
+
+struct group_task {
+    struct ext2scan *scan;
+    const struct ext2scan_visitor *visitor;
+    uint32_t group;
+};
+
+static void run_group(struct sched *sched, int worker, void *arg) {
+    struct group_task *task = arg;
+    struct ext2scan *scan = task->scan;
+
+    struct inode_walk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.ctx.arg = task->visitor->arg;
+    walk.ctx.worker = worker;
+    walk.ctx.group = task->group;
+    walk.visitor = task->visitor;
+    walk.sched = sched;
+    walk.fs = scan->fs;
+    walk.prefetch = scan->prefetch;
+
+    if (task->visitor->begin_group && !task->visitor->begin_group(&walk.ctx)) {
+        return;
+    }
+    scan_group(&walk, task->group);
+}
+
+/* Scan the bitmaps, inodes, directory entries and indirect blocks of
+ * every group and return once all callbacks have finished.
+ *
+ * Return 0 on success, -1 on error
+ */
+int ext2scan_groups(struct ext2scan *scan, const struct ext2scan_visitor *visitor) {
+    struct fs *fs = scan->fs;
+
+    struct sched *sched = sched_create(pool_size(scan->pool));
+    struct group_task *tasks = calloc(fs->num_groups, sizeof(struct group_task));
+    if (sched == NULL || tasks == NULL) {
+        sched_destroy(sched);
+        free(tasks);
+        return -1;
+    }
+
+    for (uint32_t g = 0; g < fs->num_groups; g++) {
+        tasks[g].scan = scan;
+        tasks[g].visitor = visitor;
+        tasks[g].group = g;
+        sched_submit(sched, run_group, &tasks[g]);
+    }
+
+    sched_run(sched, scan->pool);
+    sched_destroy(sched);
+    free(tasks);
+    return 0;
+}
+
+/* Walk a single inode with the inode, block, indirect and dirent callbacks,
+ * on the calling thread as worker 0.
+ *
+ * Return 0 on success, -1 if the inode cannot be read
+ */
+int ext2scan_inode(struct ext2scan *scan, uint32_t inode_id,
+        const struct ext2scan_visitor *visitor) {
+    struct ext2_inode inode_entry;
+    if (fs_read_inode(scan->fs, inode_id, &inode_entry) == -1) {
+        return -1;
+    }
+
+    struct inode_walk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.ctx.arg = visitor->arg;
+    walk.ctx.group = (inode_id - 1) / scan->fs->sb.s_inodes_per_group;
+    walk.visitor = visitor;
+    walk.fs = scan->fs;
+    visit_inode(&walk, inode_id, &inode_entry);
+    return 0;
+}
+
+/* Report the free blocks and inodes of one group with the free_blocks and
+ * free_inodes callbacks, on the calling thread as worker 0
+ */
+void ext2scan_free_runs(struct ext2scan *scan, uint32_t group,
+        const struct ext2scan_visitor *visitor) {
+    struct fs *fs = scan->fs;
+
+    struct inode_walk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.ctx.arg = visitor->arg;
+    walk.ctx.group = group;
+    walk.visitor = visitor;
+    walk.fs = fs;
+    scan_free_runs(&walk, group);
+}
@@ -0,0 +1,115 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef EXT2SCAN_H
+#define EXT2SCAN_H
+
+#include <stdint.h>
+#include "ext2_fs.h"
+#include "image.h"
+#include "fs.h"
+#include "pool.h"
+
+/* Scanner library (libext2scan).
+ *
+ * The scanner walks an opened file system and hands every object it finds
+ * to the callbacks of a visitor: the superblock and group descriptors, runs
+ * of free blocks and inodes, inodes, block references, the references held
+ * by indirect blocks and directory entries. Callbacks get pointers into the
+ * block cache or the mapped image, which are only valid for the duration of
+ * the call, and nothing is allocated per record. Any callback may be NULL.
+ *
+ * Groups are scanned concurrently on the threads of a pool and inodes with
+ * indirect blocks may be split further, so callbacks run on several threads
+ * at once. Each call gets a context naming the worker it runs on, for
+ * per-thread state, and a strand: an opaque pointer owned by the caller
+ * that follows the traversal. Within one strand, records arrive in the
+ * order of a serial scan. When part of the work is handed to another
+ * worker, the split callback creates the strand for that part, which comes
+ * right after the current one, and moves the current one past it. Callers
+ * that keep one buffer per strand can then join the buffers in chain order
+ * and get the output of a serial scan.
+ *
+ * For point queries, ext2scan_inode and ext2scan_free_runs visit a single
+ * inode or group on the calling thread.
+ */
+
+/* Returned by the inode callback */
+#define EXT2SCAN_WALK_BLOCKS 0x1        /* Visit the block references of the inode */
+#define EXT2SCAN_READ_DIRS 0x2          /* Read directory blocks for their entries */
+#define EXT2SCAN_USER_FLAGS 0xFF00      /* Kept for the caller in ctx->flags */
+
+struct ext2scan_ctx {
+    void *arg;                  /* arg of the visitor */
+    int worker;                 /* In [0, pool_size(pool)) */
+    void *strand;
+    uint32_t group;
+    uint32_t inode_id;          /* Inode being walked */
+    uint64_t size;              /* Its size in bytes */
+    int flags;                  /* Returned by the inode callback */
+};
+
+struct ext2scan_visitor {
+    void *arg;
+
+    /* Called by ext2scan_summary */
+    void (*superblock)(void *arg, const struct ext2_super_block *sb);
+    void (*group)(void *arg, uint32_t group, const struct ext2_group_desc *gd);
+
+    /* Called before a group is scanned with a NULL strand, which the
+     * callback may set. Return 0 to skip the group.
+     */
+    int (*begin_group)(struct ext2scan_ctx *ctx);
+
+    /* Return the strand for the work being handed off and move ctx->strand
+     * past it. Without this callback both keep the same strand.
+     */
+    void *(*split)(struct ext2scan_ctx *ctx);
+
+    /* Runs of free objects: [first, first + count) */
+    void (*free_blocks)(struct ext2scan_ctx *ctx, uint32_t first, uint32_t count);
+    void (*free_inodes)(struct ext2scan_ctx *ctx, uint32_t first, uint32_t count);
+
+    /* Every inode of the inode tables. Return a combination of the flags
+     * above. Without this callback the blocks of every allocated inode are
+     * walked and directories are read.
+     */
+    int (*inode)(struct ext2scan_ctx *ctx, uint32_t inode_id, const struct ext2_inode *inode);
+
+    /* Every non-zero block reference of the inode being walked, direct or
+     * held by an indirect block, before the block is read. level is the
+     * level of indirection of the referenced block, 0 for data blocks, and
+     * lbo its logical block offset, or the offset of the first data block
+     * it covers. Return 0 to leave the block out of the walk.
+     */
+    int (*block)(struct ext2scan_ctx *ctx, uint32_t block_id, uint64_t lbo, int level);
+
+    /* A reference held by an indirect block of the given level (1 to 3)
+     * that the block callback accepted
+     */
+    void (*indirect)(struct ext2scan_ctx *ctx, int level, uint64_t lbo, uint32_t block_id,
+            uint32_t ref_id);
+
+    /* A directory entry with a non-zero inode. offset is its byte offset in
+     * the directory and name_len is clamped to its record length.
+     */
+    void (*dirent)(struct ext2scan_ctx *ctx, uint64_t offset,
+            const struct ext2_dir_entry *entry, int name_len);
+};
+
+struct ext2scan;
+
+struct ext2scan *ext2scan_create(struct fs *fs, struct pool *pool);
+void ext2scan_destroy(struct ext2scan *scan);
+int ext2scan_set_prefetch(struct ext2scan *scan, int depth);
+
+void ext2scan_summary(struct ext2scan *scan, const struct ext2scan_visitor *visitor);
+int ext2scan_groups(struct ext2scan *scan, const struct ext2scan_visitor *visitor);
+int ext2scan_inode(struct ext2scan *scan, uint32_t inode_id,
+        const struct ext2scan_visitor *visitor);
+void ext2scan_free_runs(struct ext2scan *scan, uint32_t group,
+        const struct ext2scan_visitor *visitor);
+
+#endif
@@ -0,0 +1,284 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "fs.h"
+
+/* Read the superblock and the whole group descriptor table.
+ *
+ * Return 0 on success, -1 on error
+ */
+int fs_open(struct fs *fs, struct image *img) {
+    memset(fs, 0, sizeof(*fs));
+    fs->img = img;
+
+    if (image_read(img, &fs->sb, sizeof(fs->sb), SUPER_BLOCK_OFFSET) == -1) {
+        return -1;
+    }
+
+    struct ext2_super_block *sb = &fs->sb;
+    if (sb->s_magic != EXT2_SUPER_MAGIC || sb->s_log_block_size > 6 ||
+            sb->s_blocks_per_group == 0 || sb->s_inodes_per_group == 0 ||
+            sb->s_blocks_count <= sb->s_first_data_block) {
+        return -1;
+    }
+
+    fs->block_size = EXT2_MIN_BLOCK_SIZE << sb->s_log_block_size;
+    fs->inode_size = EXT2_GOOD_OLD_INODE_SIZE;
+    if (sb->s_rev_level > 0 && sb->s_inode_size >= EXT2_GOOD_OLD_INODE_SIZE) {
+        fs->inode_size = sb->s_inode_size;
+    }
+    fs->ptrs_per_block = fs->block_size / sizeof(__u32);
+    image_set_block_size(img, fs->block_size);
+
+    uint32_t data_blocks = sb->s_blocks_count - sb->s_first_data_block;
+    fs->num_groups = (data_blocks + sb->s_blocks_per_group - 1) / sb->s_blocks_per_group;
+
+    /* NOTE: The group descriptor table starts in the block after the superblock */
+    size_t table_size = (size_t) fs->num_groups * sizeof(struct ext2_group_desc);
+    fs->groups = malloc(table_size);
+    if (fs->groups == NULL) {
+        return -1;
+    }
+
+    off_t table_offset = image_block_offset(img, sb->s_first_data_block + 1);
+    if (image_read(img, fs->groups, table_size, table_offset) == -1) {
+        free(fs->groups);
+        fs->groups = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void fs_close(struct fs *fs) {
+    free(fs->groups);
+    fs->groups = NULL;
+}
+
+/* NOTE: The last group holds whatever is left over and may be smaller */
+uint32_t fs_group_blocks(struct fs *fs, uint32_t group) {
+    uint32_t per_group = fs->sb.s_blocks_per_group;
+    uint32_t remaining = fs->sb.s_blocks_count - group * per_group;
+
+    return remaining < per_group ? remaining : per_group;
+}
+
+uint32_t fs_group_inodes(struct fs *fs, uint32_t group) {
+    uint32_t per_group = fs->sb.s_inodes_per_group;
+    uint32_t remaining = fs->sb.s_inodes_count - group * per_group;
+
+    return remaining < per_group ? remaining : per_group;
+}
+
+/* Number of meaningful bits in the group's block bitmap. Bits past the last
+ * block of the file system are padding and do not describe real blocks.
+ */
+uint32_t fs_group_bitmap_blocks(struct fs *fs, uint32_t group) {
+    uint32_t first_block = fs_group_first_block(fs, group);
+    uint32_t num_bits = fs->sb.s_blocks_count - first_block;
+
+    if (num_bits > fs->sb.s_blocks_per_group) {
+        num_bits = fs->sb.s_blocks_per_group;
+    }
+    if (num_bits > (uint32_t) fs->block_size * 8) {
+        num_bits = fs->block_size * 8;
+    }
+
+    return num_bits;
+}
+
+/* Block number represented by bit 0 of the group's block bitmap */
+uint32_t fs_group_first_block(struct fs *fs, uint32_t group) {
+    return fs->sb.s_first_data_block + group * fs->sb.s_blocks_per_group;
+}
+
+/* Inode number represented by bit 0 of the group's inode bitmap */
+uint32_t fs_group_first_inode(struct fs *fs, uint32_t group) {
+    return group * fs->sb.s_inodes_per_group + 1;
+}
+
+size_t fs_inode_table_blocks(struct fs *fs) {
+    size_t table_size = (size_t) fs->sb.s_inodes_per_group * fs->inode_size;
+
+    return (table_size + fs->block_size - 1) / fs->block_size;
+}
+
+/* Inodes whose i_block array holds block numbers: allocated files,
+ * directories and symbolic links too long to be stored in i_block itself.
+ */
+int fs_inode_has_blocks(const struct ext2_inode *inode_entry) {
+    if (inode_entry->i_mode == 0 || inode_entry->i_links_count == 0) {
+        return 0;
+    }
+    if (S_ISLNK(inode_entry->i_mode)) {
+        return inode_entry->i_blocks != 0;
+    }
+    return S_ISREG(inode_entry->i_mode) || S_ISDIR(inode_entry->i_mode);
+}
+
+/* Read a single inode.
+ *
+ * Return 0 on success, -1 on error
+ */
+int fs_read_inode(struct fs *fs, uint32_t inode_id, struct ext2_inode *inode_entry) {
+    if (inode_id == 0 || inode_id > fs->sb.s_inodes_count) {
+        return -1;
+    }
+
+    uint32_t index = inode_id - 1;
+    uint32_t group = index / fs->sb.s_inodes_per_group;
+    off_t offset = image_block_offset(fs->img, fs->groups[group].bg_inode_table) +
+            (off_t) (index % fs->sb.s_inodes_per_group) * fs->inode_size;
+    return image_read(fs->img, inode_entry, sizeof(*inode_entry), offset);
+}
+
+/* Map logical block lbo of a file to a block number through the direct and
+ * indirect block pointers of its inode.
+ *
+ * Return the block number, 0 for a hole or on error
+ */
+uint32_t fs_bmap(struct fs *fs, const struct ext2_inode *inode_entry, uint64_t lbo) {
+    uint64_t ptrs = fs->ptrs_per_block;
+    if (lbo < EXT2_NDIR_BLOCKS) {
+        return inode_entry->i_block[lbo];
+    }
+
+    /* NOTE: Find the tree holding lbo and the number of blocks each pointer
+     * at its top level covers
+     */
+    lbo -= EXT2_NDIR_BLOCKS;
+    uint64_t span = 1;
+    int level = 1;
+    while (lbo >= span * ptrs) {
+        lbo -= span * ptrs;
+        span *= ptrs;
+        if (++level > 3) {
+            return 0;
+        }
+    }
+
+    uint32_t block_id = inode_entry->i_block[EXT2_NDIR_BLOCKS + level - 1];
+    for (; level > 0 && block_id != 0; level--) {
+        if (block_id >= fs->sb.s_blocks_count) {
+            return 0;
+        }
+        struct block_ref ref;
+        const uint32_t *ptr = image_get_block(fs->img, block_id, &ref);
+        if (ptr == NULL) {
+            return 0;
+        }
+        block_id = ptr[lbo / span];
+        image_put_block(fs->img, &ref);
+        lbo %= span;
+        span /= ptrs;
+    }
+
+    return block_id;
+}
+
+/* Start iterating over the inode table of a group.
+ *
+ * Return 0 on success, -1 on error
+ */
+int inode_iter_init(struct inode_iter *it, struct fs *fs, uint32_t group) {
+    memset(it, 0, sizeof(*it));
+    it->fs = fs;
+    it->table_block = fs->groups[group].bg_inode_table;
+    it->first_inode = fs_group_first_inode(fs, group);
+    it->num_inodes = fs_group_inodes(fs, group);
+    it->inodes_per_block = fs->block_size / fs->inode_size;
+
+    it->window_blocks = INODE_WINDOW_SIZE / fs->block_size;
+    if (it->window_blocks == 0) {
+        it->window_blocks = 1;
+    }
+
+    if (fs->img->map == NULL) {
+        it->buf = malloc((size_t) it->window_blocks * fs->block_size);
+        if (it->buf == NULL) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Load the window starting at inode index first and start reading the one
+ * after it ahead.
+ *
+ * Return 0 on success, -1 on error
+ */
+static int load_window(struct inode_iter *it, uint32_t first) {
+    struct fs *fs = it->fs;
+    uint32_t block = first / it->inodes_per_block;
+    uint32_t table_blocks = (it->num_inodes + it->inodes_per_block - 1) / it->inodes_per_block;
+    uint32_t num_blocks = table_blocks - block;
+    if (num_blocks > it->window_blocks) {
+        num_blocks = it->window_blocks;
+    }
+
+    off_t offset = image_block_offset(fs->img, it->table_block + block);
+    size_t len = (size_t) num_blocks * fs->block_size;
+
+    if (fs->img->map) {
+        if (offset > fs->img->size || len > (size_t) (fs->img->size - offset)) {
+            return -1;
+        }
+        it->window = fs->img->map + offset;
+    } else {
+        if (image_read(fs->img, it->buf, len, offset) == -1) {
+            return -1;
+        }
+        it->window = it->buf;
+    }
+
+    it->window_first = first;
+    it->window_count = num_blocks * it->inodes_per_block;
+    if (it->window_count > it->num_inodes - first) {
+        it->window_count = it->num_inodes - first;
+    }
+
+    if (block + num_blocks < table_blocks) {
+        image_advise(fs->img, it->table_block + block + num_blocks, it->window_blocks,
+                IMAGE_ADV_WILLNEED);
+    }
+
+    return 0;
+}
+
+/* Return the next inode of the group and store its number in inode_id.
+ *
+ * Return NULL once the table is exhausted or cannot be read
+ */
+const struct ext2_inode *inode_iter_next(struct inode_iter *it, uint32_t *inode_id) {
+    if (it->next >= it->num_inodes) {
+        return NULL;
+    }
+
+    if (it->window == NULL || it->next >= it->window_first + it->window_count) {
+        if (load_window(it, it->next) == -1) {
+            it->next = it->num_inodes;
+            return NULL;
+        }
+    }
+
+    uint32_t index = it->next++;
+    *inode_id = it->first_inode + index;
+
+    /* NOTE: Inodes are s_inode_size bytes apart on disk, which may be larger
+     * than struct ext2_inode.
+     */
+    return (const struct ext2_inode *) (it->window +
+            (size_t) (index - it->window_first) * it->fs->inode_size);
+}
+
+void inode_iter_done(struct inode_iter *it) {
+    free(it->buf);
+    it->buf = NULL;
+    it->window = NULL;
+}
@@ -0,0 +1,69 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef FS_H
+#define FS_H
+
+#include <stdint.h>
+#include "ext2_fs.h"
+#include "image.h"
+
+#define EXT2_GOOD_OLD_INODE_SIZE 128
+
+/* Decoded file system geometry shared by every pass */
+struct fs {
+    struct image *img;
+    struct ext2_super_block sb;
+    int block_size;
+    int inode_size;
+    int ptrs_per_block;         /* Number of 32-bit block pointers in a block */
+    uint32_t num_groups;
+    struct ext2_group_desc *groups;
+};
+
+int fs_open(struct fs *fs, struct image *img);
+void fs_close(struct fs *fs);
+
+uint32_t fs_group_blocks(struct fs *fs, uint32_t group);
+uint32_t fs_group_inodes(struct fs *fs, uint32_t group);
+uint32_t fs_group_bitmap_blocks(struct fs *fs, uint32_t group);
+uint32_t fs_group_first_block(struct fs *fs, uint32_t group);
+uint32_t fs_group_first_inode(struct fs *fs, uint32_t group);
+size_t fs_inode_table_blocks(struct fs *fs);
+int fs_inode_has_blocks(const struct ext2_inode *inode_entry);
+int fs_read_inode(struct fs *fs, uint32_t inode_id, struct ext2_inode *inode_entry);
+uint32_t fs_bmap(struct fs *fs, const struct ext2_inode *inode_entry, uint64_t lbo);
+
+/* Streaming iterator over the inode table of a group.
+ *
+ * The table is consumed in windows of INODE_WINDOW_SIZE bytes, so memory use
+ * does not depend on the number of inodes. While a window is being consumed
+ * the next one is already requested from the kernel, which reads it ahead
+ * into the page cache. Mapped images hand out windows straight from the
+ * mapping; otherwise each window is read into a buffer owned by the
+ * iterator and reused for every window.
+ */
+#define INODE_WINDOW_SIZE (256 * 1024)
+
+struct inode_iter {
+    struct fs *fs;
+    uint32_t table_block;       /* First block of the group's inode table */
+    uint32_t first_inode;       /* Inode number of the first table entry */
+    uint32_t num_inodes;
+    uint32_t window_blocks;
+    uint32_t inodes_per_block;
+
+    uint32_t next;              /* Index of the next inode to return */
+    uint32_t window_first;      /* Index of the first inode in the window */
+    uint32_t window_count;      /* Number of inodes in the window */
+    const unsigned char *window;
+    unsigned char *buf;         /* Window buffer for the pread fallback */
+};
+
+int inode_iter_init(struct inode_iter *it, struct fs *fs, uint32_t group);
+const struct ext2_inode *inode_iter_next(struct inode_iter *it, uint32_t *inode_id);
+void inode_iter_done(struct inode_iter *it);
+
+#endif
@@ -0,0 +1,464 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+#include "htree.h"
+
+/* NOTE: The hash functions must match the kernel's bit for bit, so they
+ * follow fs/ext4/hash.c closely
+ */
+
+#define TEA_DELTA 0x9E3779B9
+
+static void tea_transform(uint32_t buf[4], const uint32_t in[4]) {
+    uint32_t sum = 0;
+    uint32_t b0 = buf[0], b1 = buf[1];
+    uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+
+    for (int n = 0; n < 16; n++) {
+        sum += TEA_DELTA;
+        b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+        b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+    }
+
+    buf[0] += b0;
+    buf[1] += b1;
+}
+
+static inline uint32_t rol32(uint32_t x, int s) {
+    return (x << s) | (x >> (32 - s));
+}
+
+#define MD4_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD4_G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define MD4_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD4_ROUND(f, a, b, c, d, x, s) (a += f(b, c, d) + (x), a = rol32(a, s))
+#define MD4_K1 0
+#define MD4_K2 013240474631U
+#define MD4_K3 015666365641U
+
+/* MD4 cut down to three rounds of eight steps */
+static void half_md4_transform(uint32_t buf[4], const uint32_t in[8]) {
+    uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+    MD4_ROUND(MD4_F, a, b, c, d, in[0] + MD4_K1, 3);
+    MD4_ROUND(MD4_F, d, a, b, c, in[1] + MD4_K1, 7);
+    MD4_ROUND(MD4_F, c, d, a, b, in[2] + MD4_K1, 11);
+    MD4_ROUND(MD4_F, b, c, d, a, in[3] + MD4_K1, 19);
+    MD4_ROUND(MD4_F, a, b, c, d, in[4] + MD4_K1, 3);
+    MD4_ROUND(MD4_F, d, a, b, c, in[5] + MD4_K1, 7);
+    MD4_ROUND(MD4_F, c, d, a, b, in[6] + MD4_K1, 11);
+    MD4_ROUND(MD4_F, b, c, d, a, in[7] + MD4_K1, 19);
+
+    MD4_ROUND(MD4_G, a, b, c, d, in[1] + MD4_K2, 3);
+    MD4_ROUND(MD4_G, d, a, b, c, in[3] + MD4_K2, 5);
+    MD4_ROUND(MD4_G, c, d, a, b, in[5] + MD4_K2, 9);
+    MD4_ROUND(MD4_G, b, c, d, a, in[7] + MD4_K2, 13);
+    MD4_ROUND(MD4_G, a, b, c, d, in[0] + MD4_K2, 3);
+    MD4_ROUND(MD4_G, d, a, b, c, in[2] + MD4_K2, 5);
+    MD4_ROUND(MD4_G, c, d, a, b, in[4] + MD4_K2, 9);
+    MD4_ROUND(MD4_G, b, c, d, a, in[6] + MD4_K2, 13);
+
+    MD4_ROUND(MD4_H, a, b, c, d, in[3] + MD4_K3, 3);
+    MD4_ROUND(MD4_H, d, a, b, c, in[7] + MD4_K3, 9);
+    MD4_ROUND(MD4_H, c, d, a, b, in[2] + MD4_K3, 11);
+    MD4_ROUND(MD4_H, b, c, d, a, in[6] + MD4_K3, 15);
+    MD4_ROUND(MD4_H, a, b, c, d, in[1] + MD4_K3, 3);
+    MD4_ROUND(MD4_H, d, a, b, c, in[5] + MD4_K3, 9);
+    MD4_ROUND(MD4_H, c, d, a, b, in[0] + MD4_K3, 11);
+    MD4_ROUND(MD4_H, b, c, d, a, in[4] + MD4_K3, 15);
+
+    buf[0] += a;
+    buf[1] += b;
+    buf[2] += c;
+    buf[3] += d;
+}
+
+/* NOTE: The signed variants sign extend every byte of the name, as the
+ * kernel does on platforms where char is signed. Which one a file system
+ * uses is recorded in its superblock flags.
+ */
+static inline int name_byte(const char *name, int i, int is_unsigned) {
+    return is_unsigned ? (int) (unsigned char) name[i] : (int) (signed char) name[i];
+}
+
+static uint32_t dx_hack_hash(const char *name, int len, int is_unsigned) {
+    uint32_t hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+
+    for (int i = 0; i < len; i++) {
+        uint32_t hash = hash1 + (hash0 ^ (uint32_t) (name_byte(name, i, is_unsigned) * 7152373));
+        if (hash & 0x80000000) {
+            hash -= 0x7fffffff;
+        }
+        hash1 = hash0;
+        hash0 = hash;
+    }
+
+    return hash0 << 1;
+}
+
+/* Pack up to num * 4 bytes of the name into num words, padded with a
+ * pattern derived from the length
+ */
+static void str2hashbuf(const char *msg, int len, uint32_t *buf, int num, int is_unsigned) {
+    uint32_t pad = (uint32_t) len | ((uint32_t) len << 8);
+    pad |= pad << 16;
+
+    uint32_t val = pad;
+    if (len > num * 4) {
+        len = num * 4;
+    }
+    for (int i = 0; i < len; i++) {
+        val = (uint32_t) name_byte(msg, i, is_unsigned) + (val << 8);
+        if (i % 4 == 3) {
+            *buf++ = val;
+            val = pad;
+            num--;
+        }
+    }
+    if (--num >= 0) {
+        *buf++ = val;
+    }
+    while (--num >= 0) {
+        *buf++ = pad;
+    }
+}
+
+/* Hash of a name under one of the DX_HASH_* functions */
+static uint32_t dx_hash(struct fs *fs, int hash_version, const char *name, int len) {
+    uint32_t buf[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+    uint32_t in[8];
+    uint32_t hash = 0;
+
+    /* NOTE: An all zero seed means the default one */
+    const uint32_t *seed = fs->sb.s_hash_seed;
+    if (seed[0] | seed[1] | seed[2] | seed[3]) {
+        memcpy(buf, seed, sizeof(buf));
+    }
+
+    int is_unsigned = hash_version >= DX_HASH_LEGACY_UNSIGNED;
+    switch (hash_version) {
+    case DX_HASH_LEGACY:
+    case DX_HASH_LEGACY_UNSIGNED:
+        hash = dx_hack_hash(name, len, is_unsigned);
+        break;
+    case DX_HASH_HALF_MD4:
+    case DX_HASH_HALF_MD4_UNSIGNED:
+        for (int i = 0; i < len; i += 32) {
+            str2hashbuf(name + i, len - i, in, 8, is_unsigned);
+            half_md4_transform(buf, in);
+        }
+        hash = buf[1];
+        break;
+    case DX_HASH_TEA:
+    case DX_HASH_TEA_UNSIGNED:
+        for (int i = 0; i < len; i += 16) {
+            str2hashbuf(name + i, len - i, in, 4, is_unsigned);
+            tea_transform(buf, in);
+        }
+        hash = buf[0];
+        break;
+    }
+
+    /* NOTE: The lowest bit marks hash collisions in the index and the
+     * highest hash value is reserved as the end of directory marker
+     */
+    hash &= ~1U;
+    if (hash == 0xfffffffe) {
+        hash = 0xfffffffc;
+    }
+    return hash;
+}
+
+/* Entries of an index node, the countlimit being kept in place of the hash
+ * of the first one
+ */
+#define DX_MAX_LEVELS 3
+#define DX_BLOCK_MASK 0x0fffffff
+#define DX_ROOT_INFO_OFFSET 24  /* Past the "." and ".." entries */
+#define DX_NODE_OFFSET 8        /* Past the empty entry of interior nodes */
+
+struct dx_frame {
+    struct block_ref ref;
+    const struct dx_entry *entries;
+    const struct dx_entry *at;
+    int count;
+};
+
+struct dir {
+    struct fs *fs;
+    const struct ext2_inode *inode;
+    uint32_t num_blocks;
+};
+
+/* Map and fetch a block of a directory.
+ *
+ * Return NULL for holes and blocks that cannot be read
+ */
+static const char *get_dir_block(struct dir *dir, uint64_t lbo, struct block_ref *ref) {
+    if (lbo >= dir->num_blocks) {
+        return NULL;
+    }
+    uint32_t block_id = fs_bmap(dir->fs, dir->inode, lbo);
+    if (block_id == 0 || block_id >= dir->fs->sb.s_blocks_count) {
+        return NULL;
+    }
+    return image_get_block(dir->fs->img, block_id, ref);
+}
+
+/* Find a name among the entries of a directory block.
+ *
+ * Return its inode number, 0 if it is not there
+ */
+static uint32_t search_block(struct dir *dir, const char *block, const char *name, int len) {
+    int block_size = dir->fs->block_size;
+
+    int size = 0;
+    while (size <= block_size - 8) {
+        const struct ext2_dir_entry *dirent = (const void *) (block + size);
+        int rec_len = dirent->rec_len;
+
+        /* NOTE: Same bounds as the scanner; a zero rec_len ends the block */
+        if (rec_len < 8 || rec_len > block_size - size) {
+            break;
+        }
+        if (dirent->inode != 0 && dirent->name_len == len && len <= rec_len - 8 &&
+                memcmp(dirent->name, name, len) == 0) {
+            return dirent->inode;
+        }
+
+        size += rec_len;
+    }
+
+    return 0;
+}
+
+static uint32_t search_dir_block(struct dir *dir, uint64_t lbo, const char *name, int len) {
+    struct block_ref ref;
+    const char *block = get_dir_block(dir, lbo, &ref);
+    if (block == NULL) {
+        return 0;
+    }
+    uint32_t inode_id = search_block(dir, block, name, len);
+    image_put_block(dir->fs->img, &ref);
+    return inode_id;
+}
+
+static uint32_t linear_lookup(struct dir *dir, const char *name, int len) {
+    for (uint64_t lbo = 0; lbo < dir->num_blocks; lbo++) {
+        uint32_t inode_id = search_dir_block(dir, lbo, name, len);
+        if (inode_id != 0) {
+            return inode_id;
+        }
+    }
+    return 0;
+}
+
+/* Read the index node in block lbo whose countlimit is at offset into frame.
+ *
+ * Return 0 on success, -1 if it cannot be read or is not an index node
+ */
+static int read_node(struct dir *dir, uint64_t lbo, int offset, struct dx_frame *frame) {
+    const char *block = get_dir_block(dir, lbo, &frame->ref);
+    if (block == NULL) {
+        return -1;
+    }
+
+    const struct dx_countlimit *cl = (const void *) (block + offset);
+    int max_limit = (dir->fs->block_size - offset) / sizeof(struct dx_entry);
+    if (cl->limit > max_limit || cl->count == 0 || cl->count > cl->limit) {
+        image_put_block(dir->fs->img, &frame->ref);
+        return -1;
+    }
+
+    frame->entries = (const void *) (block + offset);
+    frame->count = cl->count;
+    return 0;
+}
+
+/* Binary search for the last entry whose hash is at most hash. Entry 0
+ * covers every hash below the one of entry 1.
+ */
+static const struct dx_entry *search_node(const struct dx_frame *frame, uint32_t hash) {
+    const struct dx_entry *p = frame->entries + 1;
+    const struct dx_entry *q = frame->entries + frame->count - 1;
+
+    while (p <= q) {
+        const struct dx_entry *m = p + (q - p) / 2;
+        if (m->hash > hash) {
+            q = m - 1;
+        } else {
+            p = m + 1;
+        }
+    }
+
+    return p - 1;
+}
+
+/* Move to the next leaf if it may hold more names with the same hash.
+ *
+ * Return 1 if there is one, 0 if not, -1 if the index cannot be read
+ */
+static int next_leaf(struct dir *dir, struct dx_frame *frames, int num_frames, uint32_t hash) {
+    int level = num_frames - 1;
+    while (frames[level].at + 1 >= frames[level].entries + frames[level].count) {
+        if (level == 0) {
+            return 0;
+        }
+        level--;
+    }
+    frames[level].at++;
+
+    /* NOTE: Colliding names spill into following leaves whose first hash
+     * is the same with the collision bit set
+     */
+    if ((frames[level].at->hash & ~1U) != hash) {
+        return 0;
+    }
+
+    for (level++; level < num_frames; level++) {
+        struct dx_frame next;
+        uint32_t lbo = frames[level - 1].at->block & DX_BLOCK_MASK;
+        if (read_node(dir, lbo, DX_NODE_OFFSET, &next) == -1) {
+            return -1;
+        }
+        image_put_block(dir->fs->img, &frames[level].ref);
+        frames[level] = next;
+        frames[level].at = frames[level].entries;
+    }
+
+    return 1;
+}
+
+/* Look a name up through the index.
+ *
+ * Return 0 with the inode number (0 if absent) in inode_id on success, -1 if
+ * the directory has no usable index
+ */
+static int dx_lookup(struct dir *dir, const char *name, int len, uint32_t *inode_id) {
+    struct fs *fs = dir->fs;
+    struct dx_frame frames[DX_MAX_LEVELS];
+    int num_frames = 0;
+    int rc = -1;
+
+    if (read_node(dir, 0, DX_ROOT_INFO_OFFSET + sizeof(struct dx_root_info), &frames[0]) == -1) {
+        return -1;
+    }
+    num_frames = 1;
+
+    const struct dx_root_info *info = (const void *) ((const char *) frames[0].entries -
+            sizeof(struct dx_root_info));
+    int hash_version = info->hash_version;
+    if (info->reserved_zero != 0 || info->info_length != sizeof(*info) ||
+            info->indirect_levels >= DX_MAX_LEVELS || hash_version > DX_HASH_TEA) {
+        goto out;
+    }
+    if (fs->sb.s_flags & EXT2_FLAGS_UNSIGNED_HASH) {
+        hash_version += DX_HASH_LEGACY_UNSIGNED;
+    }
+    uint32_t hash = dx_hash(fs, hash_version, name, len);
+
+    /* Walk down to the leaf covering the hash */
+    for (;;) {
+        struct dx_frame *frame = &frames[num_frames - 1];
+        frame->at = search_node(frame, hash);
+        if (num_frames > info->indirect_levels) {
+            break;
+        }
+        uint32_t lbo = frame->at->block & DX_BLOCK_MASK;
+        if (read_node(dir, lbo, DX_NODE_OFFSET, &frames[num_frames]) == -1) {
+            goto out;
+        }
+        num_frames++;
+    }
+
+    for (;;) {
+        const struct dx_frame *frame = &frames[num_frames - 1];
+        *inode_id = search_dir_block(dir, frame->at->block & DX_BLOCK_MASK, name, len);
+        if (*inode_id != 0) {
+            rc = 0;
+            break;
+        }
+
+        int next = next_leaf(dir, frames, num_frames, hash);
+        if (next != 1) {
+            rc = next;
+            break;
+        }
+    }
+
+out:
+    for (int k = 0; k < num_frames; k++) {
+        image_put_block(fs->img, &frames[k].ref);
+    }
+    return rc;
+}
+
+/* Find a name in a directory.
+ *
+ * Return its inode number, 0 if it does not exist or dir_id is not a
+ * directory
+ */
+uint32_t htree_lookup(struct fs *fs, uint32_t dir_id, const char *name, int name_len) {
+    struct ext2_inode inode;
+    if (name_len <= 0 || name_len > EXT2_NAME_LEN ||
+            fs_read_inode(fs, dir_id, &inode) == -1 ||
+            !S_ISDIR(inode.i_mode) || !fs_inode_has_blocks(&inode)) {
+        return 0;
+    }
+
+    struct dir dir;
+    dir.fs = fs;
+    dir.inode = &inode;
+    dir.num_blocks = ((uint64_t) inode.i_size + fs->block_size - 1) / fs->block_size;
+
+    /* NOTE: "." and ".." are the first two entries of block 0 and are not
+     * part of the index
+     */
+    if (name[0] == '.' && (name_len == 1 || (name_len == 2 && name[1] == '.'))) {
+        return search_dir_block(&dir, 0, name, name_len);
+    }
+
+    if ((fs->sb.s_feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX) &&
+            (inode.i_flags & EXT2_INDEX_FL)) {
+        uint32_t inode_id;
+        if (dx_lookup(&dir, name, name_len, &inode_id) == 0) {
+            return inode_id;
+        }
+    }
+
+    return linear_lookup(&dir, name, name_len);
+}
+
+/* Resolve a path from the root directory.
+ *
+ * Return the inode number it names, 0 if it does not exist
+ */
+uint32_t htree_resolve(struct fs *fs, const char *path) {
+    uint32_t inode_id = EXT2_ROOT_INO;
+
+    while (*path) {
+        const char *end = strchr(path, '/');
+        size_t len = end ? (size_t) (end - path) : strlen(path);
+
+        if (len > EXT2_NAME_LEN) {
+            return 0;
+        }
+        if (len != 0 && !(len == 1 && path[0] == '.')) {
+            inode_id = htree_lookup(fs, inode_id, path, len);
+            if (inode_id == 0) {
+                return 0;
+            }
+        }
+
+        path += len;
+        if (*path == '/') {
+            path++;
+        }
+    }
+
+    return inode_id;
+}
@@ -0,0 +1,26 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef HTREE_H
+#define HTREE_H
+
+#include <stdint.h>
+#include "fs.h"
+
+/* Name lookups that use the hashed (htree) index of large directories.
+ *
+ * The name is hashed with the directory's hash function and the index is
+ * searched by binary search from the root down to a single leaf block, so
+ * a lookup reads one block per index level plus the leaf instead of the
+ * whole directory. Directories without a valid index, and file systems
+ * without dir_index, fall back to reading every block.
+ *
+ * Resolving a path reads one directory per component and needs no scan.
+ */
+
+uint32_t htree_lookup(struct fs *fs, uint32_t dir_id, const char *name, int name_len);
+uint32_t htree_resolve(struct fs *fs, const char *path);
+
+#endif
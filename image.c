@@ -0,0 +1,258 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "image.h"
+#include "ext2_fs.h"
+
+/* Open the image and try to map it.
+ *
+ * Return 0 on success, -1 on error
+ */
+int image_open(struct image *img, const char *path, int flags) {
+    memset(img, 0, sizeof(*img));
+    img->fd = open(path, O_RDONLY);
+    if (img->fd == -1) {
+        return -1;
+    }
+
+    /* NOTE: Block devices report a size of zero through fstat */
+    struct stat st;
+    if (fstat(img->fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        img->size = st.st_size;
+    } else {
+        img->size = lseek(img->fd, 0, SEEK_END);
+    }
+    if (img->size < 0) {
+        img->size = 0;
+    }
+
+    img->block_size = EXT2_MIN_BLOCK_SIZE;
+
+    if (!(flags & IMAGE_NO_MMAP) && img->size > 0 &&
+            (uint64_t) img->size <= SIZE_MAX) {
+        void *map = mmap(NULL, img->size, PROT_READ, MAP_SHARED, img->fd, 0);
+        if (map != MAP_FAILED) {
+            img->map = map;
+        }
+    }
+
+    return 0;
+}
+
+void image_close(struct image *img) {
+    cache_destroy(img->cache);
+    img->cache = NULL;
+    if (img->map) {
+        munmap(img->map, img->size);
+        img->map = NULL;
+    }
+    if (img->fd != -1) {
+        close(img->fd);
+        img->fd = -1;
+    }
+}
+
+void image_set_block_size(struct image *img, int block_size) {
+    if (img->cache && block_size != img->block_size) {
+        cache_destroy(img->cache);
+        img->cache = NULL;
+    }
+    img->block_size = block_size;
+}
+
+static int fill_block(void *arg, uint32_t block_id, void *buf) {
+    struct image *img = arg;
+
+    return image_read(img, buf, img->block_size, image_block_offset(img, block_id));
+}
+
+/* Set up a cache of num_blocks blocks for the pread fallback. Mapped images
+ * already get their blocks straight from the page cache and skip it.
+ *
+ * Return 0 on success, -1 on error
+ */
+int image_set_cache(struct image *img, size_t num_blocks) {
+    cache_destroy(img->cache);
+    img->cache = NULL;
+
+    if (img->map || num_blocks == 0) {
+        return 0;
+    }
+
+    img->cache = cache_create(num_blocks, img->block_size, fill_block, img);
+
+    return img->cache ? 0 : -1;
+}
+
+void image_cache_stats(struct image *img, struct cache_stats *stats) {
+    cache_get_stats(img->cache, stats);
+}
+
+/* NOTE: Block 0 starts at the beginning of the image. With 1 KiB blocks the
+ * superblock lives in block 1, with larger blocks it is inside block 0.
+ */
+off_t image_block_offset(struct image *img, uint32_t block_id) {
+    return (off_t) block_id * img->block_size;
+}
+
+/* Copy len bytes at offset into buf.
+ *
+ * Return 0 on success, -1 if the range is not fully inside the image
+ */
+int image_read(struct image *img, void *buf, size_t len, off_t offset) {
+    if (offset < 0 || offset > img->size || len > (size_t) (img->size - offset)) {
+        return -1;
+    }
+
+    if (img->map) {
+        memcpy(buf, img->map + offset, len);
+        return 0;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(img->fd, (char *) buf + done, len - done, offset + done);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        done += n;
+    }
+
+    /* NOTE: Relaxed counters cost next to nothing next to the syscall */
+    __atomic_fetch_add(&img->reads, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&img->read_bytes, len, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/* Get a pointer to num_blocks consecutive blocks starting at block_id.
+ * Mapped images return a pointer into the mapping, otherwise single blocks
+ * come from the block cache and longer runs are read into a buffer owned
+ * by ref.
+ *
+ * Return NULL if the blocks are not inside the image
+ */
+const void *image_get_blocks(struct image *img, uint32_t block_id,
+        size_t num_blocks, struct block_ref *ref) {
+    off_t offset = image_block_offset(img, block_id);
+    size_t len = num_blocks * img->block_size;
+
+    ref->data = NULL;
+    ref->buf = NULL;
+    ref->entry = NULL;
+
+    if (offset > img->size || len > (size_t) (img->size - offset)) {
+        return NULL;
+    }
+
+    if (img->map) {
+        ref->data = img->map + offset;
+        return ref->data;
+    }
+
+    if (img->cache && num_blocks == 1) {
+        ref->data = cache_get(img->cache, block_id, &ref->entry);
+        if (ref->data) {
+            return ref->data;
+        }
+    }
+
+    ref->buf = malloc(len);
+    if (ref->buf == NULL) {
+        return NULL;
+    }
+    if (image_read(img, ref->buf, len, offset) == -1) {
+        free(ref->buf);
+        ref->buf = NULL;
+        return NULL;
+    }
+
+    ref->data = ref->buf;
+    return ref->data;
+}
+
+void image_put_blocks(struct image *img, struct block_ref *ref) {
+    if (ref->entry) {
+        cache_put(img->cache, ref->entry);
+        ref->entry = NULL;
+    }
+    free(ref->buf);
+    ref->buf = NULL;
+    ref->data = NULL;
+}
+
+/* Tell the kernel how the next phase will touch a range of blocks.
+ * A num_blocks of zero covers everything up to the end of the image.
+ */
+void image_advise(struct image *img, uint32_t block_id, size_t num_blocks,
+        enum image_advice advice) {
+    off_t offset = image_block_offset(img, block_id);
+    if (offset >= img->size) {
+        return;
+    }
+
+    off_t len = img->size - offset;
+    if (num_blocks != 0 && (off_t) (num_blocks * img->block_size) < len) {
+        len = num_blocks * img->block_size;
+    }
+
+    if (img->map) {
+        int madv;
+        switch (advice) {
+            case IMAGE_ADV_SEQUENTIAL:
+                madv = MADV_SEQUENTIAL;
+                break;
+            case IMAGE_ADV_RANDOM:
+                madv = MADV_RANDOM;
+                break;
+            case IMAGE_ADV_WILLNEED:
+                madv = MADV_WILLNEED;
+                break;
+            case IMAGE_ADV_DONTNEED:
+                madv = MADV_DONTNEED;
+                break;
+            default:
+                madv = MADV_NORMAL;
+                break;
+        }
+
+        /* NOTE: madvise requires a page aligned start address */
+        long page_size = sysconf(_SC_PAGESIZE);
+        off_t aligned = offset & ~((off_t) page_size - 1);
+        madvise(img->map + aligned, len + (offset - aligned), madv);
+        return;
+    }
+
+    int fadv;
+    switch (advice) {
+        case IMAGE_ADV_SEQUENTIAL:
+            fadv = POSIX_FADV_SEQUENTIAL;
+            break;
+        case IMAGE_ADV_RANDOM:
+            fadv = POSIX_FADV_RANDOM;
+            break;
+        case IMAGE_ADV_WILLNEED:
+            fadv = POSIX_FADV_WILLNEED;
+            break;
+        case IMAGE_ADV_DONTNEED:
+            fadv = POSIX_FADV_DONTNEED;
+            break;
+        default:
+            fadv = POSIX_FADV_NORMAL;
+            break;
+    }
+    posix_fadvise(img->fd, offset, len, fadv);
+}
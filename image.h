@@ -0,0 +1,80 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "cache.h"
+
+#define SUPER_BLOCK_OFFSET 1024
+
+/* Image access layer.
+ *
+ * The image is memory-mapped whenever possible so that blocks can be handed
+ * out as direct pointers into the mapping. Inputs that cannot be mapped fall
+ * back to pread; single blocks are then served from an LRU block cache and
+ * larger runs are read into a buffer owned by the block reference.
+ */
+
+#define IMAGE_NO_MMAP 0x1
+
+/* Access pattern hints for the upcoming phase */
+enum image_advice {
+    IMAGE_ADV_NORMAL,
+    IMAGE_ADV_SEQUENTIAL,
+    IMAGE_ADV_RANDOM,
+    IMAGE_ADV_WILLNEED,
+    IMAGE_ADV_DONTNEED
+};
+
+struct image {
+    int fd;
+    off_t size;
+    unsigned char *map;     /* NULL when using the pread fallback */
+    int block_size;
+    struct block_cache *cache;  /* Only used by the pread fallback */
+    uint64_t reads;         /* pread calls, updated atomically */
+    uint64_t read_bytes;
+};
+
+/* Reference to a run of blocks obtained from image_get_blocks. Must be
+ * released with image_put_blocks once the data is no longer needed.
+ */
+struct block_ref {
+    const unsigned char *data;
+    void *buf;              /* heap buffer owned by the pread fallback */
+    struct cache_entry *entry;  /* pinned cache entry */
+};
+
+int image_open(struct image *img, const char *path, int flags);
+void image_close(struct image *img);
+void image_set_block_size(struct image *img, int block_size);
+int image_set_cache(struct image *img, size_t num_blocks);
+void image_cache_stats(struct image *img, struct cache_stats *stats);
+
+off_t image_block_offset(struct image *img, uint32_t block_id);
+int image_read(struct image *img, void *buf, size_t len, off_t offset);
+
+const void *image_get_blocks(struct image *img, uint32_t block_id,
+        size_t num_blocks, struct block_ref *ref);
+void image_put_blocks(struct image *img, struct block_ref *ref);
+
+/* Convenience wrappers for a single block */
+static inline const void *image_get_block(struct image *img, uint32_t block_id,
+        struct block_ref *ref) {
+    return image_get_blocks(img, block_id, 1, ref);
+}
+
+static inline void image_put_block(struct image *img, struct block_ref *ref) {
+    image_put_blocks(img, ref);
+}
+
+void image_advise(struct image *img, uint32_t block_id, size_t num_blocks,
+        enum image_advice advice);
+
+#endif
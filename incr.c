@@ -0,0 +1,337 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "incr.h"
+#include "outbuf.h"
+
+/* Inode table blocks hashed per image_get_blocks call */
+#define INCR_WINDOW_BLOCKS 256
+
+struct incr_entry {
+    uint64_t fingerprint;
+    struct incr_stream streams[];
+};
+
+struct incr {
+    struct fs *fs;
+    char *path;
+    char *tmp_path;             /* New index until it is complete */
+    struct incr_header header;
+    size_t entry_size;
+
+    /* Previous run, NULL if there was none or it does not match */
+    const unsigned char *map;
+    size_t map_size;
+
+    uint64_t *fingerprints;     /* Current fingerprint of each group */
+
+    /* New index being written */
+    unsigned char *entries;
+    struct outbuf out;
+    int fd;
+    uint64_t data_offset;
+};
+
+static struct incr_entry *entry_at(struct incr *inc, const unsigned char *entries,
+        uint32_t group) {
+    return (struct incr_entry *) (entries + (size_t) group * inc->entry_size);
+}
+
+/* Check that a previous index describes the same file system and output
+ * options, and that all of its streams lie inside the file
+ */
+static int valid_index(struct incr *inc) {
+    const struct incr_header *h = (const void *) inc->map;
+    size_t table_size = sizeof(*h) + (size_t) inc->header.num_groups * inc->entry_size;
+
+    if (inc->map_size < table_size || memcmp(h, &inc->header, sizeof(*h)) != 0) {
+        return 0;
+    }
+
+    for (uint32_t g = 0; g < h->num_groups; g++) {
+        const struct incr_entry *e = entry_at(inc, inc->map + sizeof(*h), g);
+        for (uint32_t s = 0; s < h->num_streams; s++) {
+            if (e->streams[s].offset > inc->map_size ||
+                    e->streams[s].len > inc->map_size - e->streams[s].offset) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/* Open the index at path for a scan of fs. A missing or stale index is not
+ * an error; every group is then scanned.
+ *
+ * Return NULL on error
+ */
+struct incr *incr_open(const char *path, struct fs *fs, uint32_t flags, int num_streams) {
+    struct incr *inc = calloc(1, sizeof(*inc));
+    if (inc == NULL) {
+        return NULL;
+    }
+    inc->fs = fs;
+    inc->fd = -1;
+    inc->path = strdup(path);
+    inc->tmp_path = malloc(strlen(path) + sizeof(".tmp"));
+    inc->fingerprints = calloc(fs->num_groups, sizeof(uint64_t));
+    if (inc->path == NULL || inc->tmp_path == NULL || inc->fingerprints == NULL) {
+        incr_close(inc);
+        return NULL;
+    }
+    strcpy(inc->tmp_path, path);
+    strcat(inc->tmp_path, ".tmp");
+
+    struct incr_header *h = &inc->header;
+    memcpy(h->magic, INCR_MAGIC, sizeof(h->magic));
+    h->version = INCR_VERSION;
+    h->flags = flags;
+    h->block_size = fs->block_size;
+    h->blocks_count = fs->sb.s_blocks_count;
+    h->inodes_count = fs->sb.s_inodes_count;
+    h->num_groups = fs->num_groups;
+    h->num_streams = num_streams;
+    inc->entry_size = sizeof(struct incr_entry) + num_streams * sizeof(struct incr_stream);
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return inc;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(*h)) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            inc->map = map;
+            inc->map_size = st.st_size;
+            if (!valid_index(inc)) {
+                munmap(map, st.st_size);
+                inc->map = NULL;
+            }
+        }
+    }
+    close(fd);
+
+    return inc;
+}
+
+void incr_close(struct incr *inc) {
+    if (inc == NULL) {
+        return;
+    }
+    if (inc->map) {
+        munmap((void *) inc->map, inc->map_size);
+    }
+    if (inc->fd != -1) {
+        close(inc->fd);
+        outbuf_free(&inc->out);
+    }
+    free(inc->entries);
+    free(inc->fingerprints);
+    free(inc->tmp_path);
+    free(inc->path);
+    free(inc);
+}
+
+/* Word-at-a-time multiplicative hash. It only has to notice changes, not
+ * resist crafted collisions.
+ */
+static uint64_t hash_mem(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        h = (h ^ *p++) * 0x100000001B3ULL;
+        len--;
+    }
+
+    return h;
+}
+
+static uint64_t hash_blocks(struct fs *fs, uint64_t h, uint32_t block_id, size_t num_blocks) {
+    struct block_ref ref;
+    const void *data = image_get_blocks(fs->img, block_id, num_blocks, &ref);
+    if (data == NULL) {
+        /* NOTE: Unreadable blocks still count, so they are never cached */
+        return hash_mem(h ^ 0xFF, &block_id, sizeof(block_id));
+    }
+    h = hash_mem(h, data, num_blocks * fs->block_size);
+    image_put_blocks(fs->img, &ref);
+    return h;
+}
+
+/* Hash a block of a directory and, for indirect blocks, everything below it */
+static uint64_t hash_tree(struct fs *fs, uint64_t h, uint32_t block_id, int level) {
+    if (block_id == 0 || block_id >= fs->sb.s_blocks_count) {
+        return h;
+    }
+    if (level == 0) {
+        return hash_blocks(fs, h, block_id, 1);
+    }
+
+    struct block_ref ref;
+    const __u32 *ptr = image_get_block(fs->img, block_id, &ref);
+    if (ptr == NULL) {
+        return hash_mem(h ^ 0xFF, &block_id, sizeof(block_id));
+    }
+    h = hash_mem(h, ptr, fs->block_size);
+    for (int i = 0; i < fs->ptrs_per_block; i++) {
+        h = hash_tree(fs, h, ptr[i], level - 1);
+    }
+    image_put_block(fs->img, &ref);
+    return h;
+}
+
+/* Hash the blocks of the directories in a group. Adding an entry does not
+ * have to touch the directory's inode (debugfs does not), so the inode
+ * table alone would miss it.
+ */
+static uint64_t hash_dirs(struct fs *fs, uint64_t h, uint32_t group) {
+    struct inode_iter it;
+    if (inode_iter_init(&it, fs, group) == -1) {
+        return h ^ 0xFF;
+    }
+
+    const struct ext2_inode *inode_entry;
+    uint32_t inode_id;
+    while ((inode_entry = inode_iter_next(&it, &inode_id)) != NULL) {
+        if (!S_ISDIR(inode_entry->i_mode) || !fs_inode_has_blocks(inode_entry)) {
+            continue;
+        }
+        for (int k = 0; k < EXT2_N_BLOCKS; k++) {
+            int level = k < EXT2_NDIR_BLOCKS ? 0 : k - EXT2_NDIR_BLOCKS + 1;
+            h = hash_tree(fs, h, inode_entry->i_block[k], level);
+        }
+    }
+
+    inode_iter_done(&it);
+    return h;
+}
+
+static void fingerprint_group(void *arg, size_t group) {
+    struct incr *inc = arg;
+    struct fs *fs = inc->fs;
+    const struct ext2_group_desc *gd = &fs->groups[group];
+
+    uint64_t h = 0xCBF29CE484222325ULL;
+    h = hash_mem(h, gd, sizeof(*gd));
+    h = hash_blocks(fs, h, gd->bg_block_bitmap, 1);
+    h = hash_blocks(fs, h, gd->bg_inode_bitmap, 1);
+
+    size_t table_blocks = fs_inode_table_blocks(fs);
+    for (size_t b = 0; b < table_blocks; b += INCR_WINDOW_BLOCKS) {
+        size_t n = table_blocks - b < INCR_WINDOW_BLOCKS ? table_blocks - b : INCR_WINDOW_BLOCKS;
+        h = hash_blocks(fs, h, gd->bg_inode_table + b, n);
+    }
+    h = hash_dirs(fs, h, group);
+
+    inc->fingerprints[group] = h;
+}
+
+/* Fingerprint every group of the file system */
+void incr_fingerprint(struct incr *inc, struct pool *pool) {
+    pool_for(pool, inc->fs->num_groups, fingerprint_group, inc);
+}
+
+/* Return 1 if the records of a group can be taken from the index */
+int incr_cached(struct incr *inc, uint32_t group) {
+    if (inc->map == NULL) {
+        return 0;
+    }
+    const struct incr_entry *e = entry_at(inc, inc->map + sizeof(struct incr_header), group);
+    return e->fingerprint == inc->fingerprints[group];
+}
+
+const void *incr_records(struct incr *inc, uint32_t group, int stream, size_t *len) {
+    const struct incr_entry *e = entry_at(inc, inc->map + sizeof(struct incr_header), group);
+    *len = e->streams[stream].len;
+    return inc->map + e->streams[stream].offset;
+}
+
+/* Start writing the new index next to the old one. Records must then be
+ * saved group by group, and stream by stream within a group.
+ *
+ * Return 0 on success, -1 on error
+ */
+int incr_save_begin(struct incr *inc) {
+    size_t table_size = (size_t) inc->header.num_groups * inc->entry_size;
+    inc->entries = calloc(1, table_size ? table_size : 1);
+    if (inc->entries == NULL) {
+        return -1;
+    }
+    for (uint32_t g = 0; g < inc->header.num_groups; g++) {
+        entry_at(inc, inc->entries, g)->fingerprint = inc->fingerprints[g];
+    }
+
+    inc->fd = open(inc->tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (inc->fd == -1) {
+        return -1;
+    }
+    if (outbuf_init(&inc->out, inc->fd, OUTBUF_DEFAULT_SIZE) == -1) {
+        return -1;
+    }
+
+    /* NOTE: The header and the table are written last, in front */
+    inc->data_offset = sizeof(struct incr_header) + table_size;
+    if (lseek(inc->fd, inc->data_offset, SEEK_SET) == -1) {
+        inc->out.error = 1;
+    }
+    return 0;
+}
+
+void incr_save_records(struct incr *inc, uint32_t group, int stream, const void *data,
+        size_t len) {
+    struct incr_stream *s = &entry_at(inc, inc->entries, group)->streams[stream];
+    if (s->len == 0) {
+        s->offset = inc->data_offset;
+    }
+    s->len += len;
+    inc->data_offset += len;
+    outbuf_put_mem(&inc->out, data, len);
+}
+
+/* Finish the new index and put it in place of the old one.
+ *
+ * Return 0 on success, -1 on error
+ */
+int incr_save_end(struct incr *inc) {
+    int rc = outbuf_flush(&inc->out);
+    outbuf_free(&inc->out);
+
+    size_t table_size = (size_t) inc->header.num_groups * inc->entry_size;
+    if (rc == 0 && (pwrite(inc->fd, &inc->header, sizeof(inc->header), 0) !=
+            sizeof(inc->header) || pwrite(inc->fd, inc->entries, table_size,
+            sizeof(inc->header)) != (ssize_t) table_size)) {
+        rc = -1;
+    }
+    if (close(inc->fd) == -1) {
+        rc = -1;
+    }
+    inc->fd = -1;
+
+    if (rc == 0 && rename(inc->tmp_path, inc->path) == -1) {
+        rc = -1;
+    }
+    if (rc == -1) {
+        unlink(inc->tmp_path);
+    }
+
+    return rc;
+}
@@ -0,0 +1,64 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef INCR_H
+#define INCR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fs.h"
+#include "pool.h"
+
+/* Incremental re-scan index (--incremental).
+ *
+ * The sidecar file keeps, for every group, a fingerprint of its group
+ * descriptor, bitmaps, inode table and directory blocks, along with the
+ * records the group produced in each output stream. A later run
+ * fingerprints the groups again and only scans the ones whose fingerprint
+ * changed; the records of the others are copied from the index.
+ *
+ * NOTE: The indirect blocks of regular files are not part of the
+ * fingerprint. Remapping a block also changes the owning inode (block
+ * count or times), which changes the inode table.
+ *
+ * Layout: a header, then one entry per group holding its fingerprint and
+ * the offset and length of each stream, then the records themselves.
+ */
+
+#define INCR_MAGIC "EXT2INCR"
+#define INCR_VERSION 1
+
+struct incr_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;             /* Output options the records depend on */
+    uint32_t block_size;
+    uint32_t blocks_count;
+    uint32_t inodes_count;
+    uint32_t num_groups;
+    uint32_t num_streams;
+    uint32_t reserved;
+};
+
+struct incr_stream {
+    uint64_t offset;
+    uint64_t len;
+};
+
+struct incr;
+
+struct incr *incr_open(const char *path, struct fs *fs, uint32_t flags, int num_streams);
+void incr_close(struct incr *inc);
+
+void incr_fingerprint(struct incr *inc, struct pool *pool);
+int incr_cached(struct incr *inc, uint32_t group);
+const void *incr_records(struct incr *inc, uint32_t group, int stream, size_t *len);
+
+int incr_save_begin(struct incr *inc);
+void incr_save_records(struct incr *inc, uint32_t group, int stream, const void *data,
+        size_t len);
+int incr_save_end(struct incr *inc);
+
+#endif
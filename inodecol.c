@@ -0,0 +1,393 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "inodecol.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_AVX2_PATH 1
+#endif
+
+/* Rows handled by one call of the filter; columns are allocated in whole
+ * chunks, with zero padding after the last inode
+ */
+#define CHUNK_ROWS 8192
+#define CHUNK_WORDS (CHUNK_ROWS / 64)
+
+/* Comparison operators. Each one is a base comparison, possibly negated */
+enum {
+    OP_EQ,
+    OP_NE,
+    OP_LT,
+    OP_GE,
+    OP_GT,
+    OP_LE
+};
+
+static const char *field_names[] = {
+    "mode", "uid", "gid", "links", "ctime", "mtime", "atime", "size"
+};
+
+static const char *skip_space(const char *p) {
+    while (isspace((unsigned char) *p)) {
+        p++;
+    }
+    return p;
+}
+
+/* Parse a query expression, see inodecol.h.
+ *
+ * Return 0 on success, -1 on a syntax error
+ */
+int inodecol_parse(struct inodecol_query *query, const char *expr) {
+    memset(query, 0, sizeof(*query));
+
+    const char *p = skip_space(expr);
+    int new_term = 1;
+    for (;;) {
+        if (query->num_preds == INODECOL_MAX_PREDS) {
+            return -1;
+        }
+        struct inodecol_pred *pred = &query->preds[query->num_preds++];
+        pred->new_term = new_term;
+
+        size_t len = 0;
+        while (isalpha((unsigned char) p[len])) {
+            len++;
+        }
+        pred->field = -1;
+        for (size_t f = 0; f < sizeof(field_names) / sizeof(field_names[0]); f++) {
+            if (strlen(field_names[f]) == len && strncmp(p, field_names[f], len) == 0) {
+                pred->field = f;
+            }
+        }
+        if (pred->field == -1) {
+            return -1;
+        }
+        p = skip_space(p + len);
+
+        if (strncmp(p, "==", 2) == 0) {
+            pred->op = OP_EQ;
+            p += 2;
+        } else if (strncmp(p, "!=", 2) == 0) {
+            pred->op = OP_NE;
+            p += 2;
+        } else if (strncmp(p, "<=", 2) == 0) {
+            pred->op = OP_LE;
+            p += 2;
+        } else if (strncmp(p, ">=", 2) == 0) {
+            pred->op = OP_GE;
+            p += 2;
+        } else if (*p == '<') {
+            pred->op = OP_LT;
+            p++;
+        } else if (*p == '>') {
+            pred->op = OP_GT;
+            p++;
+        } else {
+            return -1;
+        }
+        p = skip_space(p);
+
+        if (!isdigit((unsigned char) *p)) {
+            return -1;
+        }
+        char *end;
+        errno = 0;
+        pred->value = strtoull(p, &end, 0);
+        if (errno != 0) {
+            return -1;
+        }
+        p = skip_space(end);
+
+        if (*p == '\0') {
+            return 0;
+        } else if (strncmp(p, "&&", 2) == 0) {
+            new_term = 0;
+        } else if (strncmp(p, "||", 2) == 0) {
+            new_term = 1;
+        } else {
+            return -1;
+        }
+        p = skip_space(p + 2);
+    }
+}
+
+struct load_ctx {
+    struct inodecol *ic;
+    struct fs *fs;
+};
+
+static void load_group(void *arg, size_t group) {
+    struct load_ctx *ctx = arg;
+    struct inodecol *ic = ctx->ic;
+
+    struct inode_iter it;
+    if (inode_iter_init(&it, ctx->fs, group) == -1) {
+        return;
+    }
+
+    const struct ext2_inode *inode_entry;
+    uint32_t inode_id;
+    while ((inode_entry = inode_iter_next(&it, &inode_id)) != NULL) {
+        uint32_t row = inode_id - 1;
+        ic->u32[INODECOL_MODE][row] = inode_entry->i_mode;
+        ic->u32[INODECOL_UID][row] = inode_entry->i_uid;
+        ic->u32[INODECOL_GID][row] = inode_entry->i_gid;
+        ic->u32[INODECOL_LINKS][row] = inode_entry->i_links_count;
+        ic->u32[INODECOL_CTIME][row] = inode_entry->i_ctime;
+        ic->u32[INODECOL_MTIME][row] = inode_entry->i_mtime;
+        ic->u32[INODECOL_ATIME][row] = inode_entry->i_atime;
+
+        uint64_t size = inode_entry->i_size;
+        if (S_ISREG(inode_entry->i_mode)) {
+            size |= (uint64_t) inode_entry->i_size_high << 32;
+        }
+        ic->size[row] = size;
+    }
+
+    inode_iter_done(&it);
+}
+
+/* Decode every inode table into columns, one group per task.
+ *
+ * Return 0 on success, -1 on error
+ */
+int inodecol_load(struct inodecol *ic, struct fs *fs, struct pool *pool) {
+    memset(ic, 0, sizeof(*ic));
+    ic->fs = fs;
+    ic->num_rows = fs->sb.s_inodes_count;
+
+    size_t cap = ((size_t) ic->num_rows + CHUNK_ROWS - 1) / CHUNK_ROWS * CHUNK_ROWS;
+    if (cap == 0) {
+        cap = CHUNK_ROWS;
+    }
+    for (int f = 0; f < INODECOL_NUM_U32; f++) {
+        ic->u32[f] = calloc(cap, sizeof(uint32_t));
+        if (ic->u32[f] == NULL) {
+            inodecol_free(ic);
+            return -1;
+        }
+    }
+    ic->size = calloc(cap, sizeof(uint64_t));
+    if (ic->size == NULL) {
+        inodecol_free(ic);
+        return -1;
+    }
+
+    struct load_ctx ctx;
+    ctx.ic = ic;
+    ctx.fs = fs;
+    pool_for(pool, fs->num_groups, load_group, &ctx);
+    return 0;
+}
+
+void inodecol_free(struct inodecol *ic) {
+    for (int f = 0; f < INODECOL_NUM_U32; f++) {
+        free(ic->u32[f]);
+        ic->u32[f] = NULL;
+    }
+    free(ic->size);
+    ic->size = NULL;
+}
+
+/* Base comparisons over 64 rows. Bit i of the result is set if row i
+ * compares op (OP_EQ, OP_LT or OP_GT) to v.
+ */
+static uint64_t cmp_u32(const uint32_t *col, int op, uint32_t v) {
+    uint64_t m = 0;
+    for (int i = 0; i < 64; i++) {
+        int r = op == OP_EQ ? col[i] == v : op == OP_LT ? col[i] < v : col[i] > v;
+        m |= (uint64_t) r << i;
+    }
+    return m;
+}
+
+static uint64_t cmp_u64(const uint64_t *col, int op, uint64_t v) {
+    uint64_t m = 0;
+    for (int i = 0; i < 64; i++) {
+        int r = op == OP_EQ ? col[i] == v : op == OP_LT ? col[i] < v : col[i] > v;
+        m |= (uint64_t) r << i;
+    }
+    return m;
+}
+
+#ifdef HAVE_AVX2_PATH
+/* NOTE: AVX2 only compares signed integers; flipping the sign bit of both
+ * sides turns that into an unsigned comparison
+ */
+__attribute__((target("avx2")))
+static uint64_t cmp_u32_avx2(const uint32_t *col, int op, uint32_t v) {
+    const __m256i bias = _mm256_set1_epi32(INT32_MIN);
+    __m256i vv = _mm256_xor_si256(_mm256_set1_epi32(v), bias);
+    uint64_t m = 0;
+    for (int k = 0; k < 8; k++) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (col + 8 * k));
+        x = _mm256_xor_si256(x, bias);
+        __m256i r;
+        if (op == OP_EQ) {
+            r = _mm256_cmpeq_epi32(x, vv);
+        } else if (op == OP_LT) {
+            r = _mm256_cmpgt_epi32(vv, x);
+        } else {
+            r = _mm256_cmpgt_epi32(x, vv);
+        }
+        m |= (uint64_t) (uint32_t) _mm256_movemask_ps(_mm256_castsi256_ps(r)) << (8 * k);
+    }
+    return m;
+}
+
+__attribute__((target("avx2")))
+static uint64_t cmp_u64_avx2(const uint64_t *col, int op, uint64_t v) {
+    const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+    __m256i vv = _mm256_xor_si256(_mm256_set1_epi64x(v), bias);
+    uint64_t m = 0;
+    for (int k = 0; k < 16; k++) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (col + 4 * k));
+        x = _mm256_xor_si256(x, bias);
+        __m256i r;
+        if (op == OP_EQ) {
+            r = _mm256_cmpeq_epi64(x, vv);
+        } else if (op == OP_LT) {
+            r = _mm256_cmpgt_epi64(vv, x);
+        } else {
+            r = _mm256_cmpgt_epi64(x, vv);
+        }
+        m |= (uint64_t) (uint32_t) _mm256_movemask_pd(_mm256_castsi256_pd(r)) << (4 * k);
+    }
+    return m;
+}
+
+static int have_avx2(void) {
+    static int cached = -1;
+    if (cached == -1) {
+        __builtin_cpu_init();
+        cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return cached;
+}
+#endif
+
+struct filter_ctx {
+    struct inodecol *ic;
+    const struct inodecol_query *query;
+    uint64_t *matches;
+    int use_avx2;
+};
+
+/* Evaluate one comparison over the rows of a chunk into masks */
+static void eval_pred(struct filter_ctx *ctx, const struct inodecol_pred *pred, size_t row,
+        uint64_t *masks) {
+    /* NOTE: NE, GE and LE are the negations of EQ, LT and GT */
+    int op = pred->op & ~1;
+    uint64_t flip = (pred->op & 1) ? ~(uint64_t) 0 : 0;
+
+    if (pred->field == INODECOL_SIZE) {
+        const uint64_t *col = ctx->ic->size + row;
+        for (int w = 0; w < CHUNK_WORDS; w++) {
+#ifdef HAVE_AVX2_PATH
+            if (ctx->use_avx2) {
+                masks[w] = cmp_u64_avx2(col + w * 64, op, pred->value) ^ flip;
+                continue;
+            }
+#endif
+            masks[w] = cmp_u64(col + w * 64, op, pred->value) ^ flip;
+        }
+        return;
+    }
+
+    /* NOTE: Values past the range of a 32-bit field decide the comparison
+     * on their own
+     */
+    if (pred->value > UINT32_MAX) {
+        uint64_t m = op == OP_LT ? ~(uint64_t) 0 : 0;
+        for (int w = 0; w < CHUNK_WORDS; w++) {
+            masks[w] = m ^ flip;
+        }
+        return;
+    }
+
+    const uint32_t *col = ctx->ic->u32[pred->field] + row;
+    for (int w = 0; w < CHUNK_WORDS; w++) {
+#ifdef HAVE_AVX2_PATH
+        if (ctx->use_avx2) {
+            masks[w] = cmp_u32_avx2(col + w * 64, op, pred->value) ^ flip;
+            continue;
+        }
+#endif
+        masks[w] = cmp_u32(col + w * 64, op, pred->value) ^ flip;
+    }
+}
+
+/* Evaluate the query over one chunk of rows, a comparison at a time */
+static void filter_chunk(void *arg, size_t chunk) {
+    struct filter_ctx *ctx = arg;
+    const struct inodecol_query *query = ctx->query;
+    size_t row = chunk * CHUNK_ROWS;
+    uint64_t *result = ctx->matches + chunk * CHUNK_WORDS;
+
+    uint64_t term[CHUNK_WORDS];
+    uint64_t masks[CHUNK_WORDS];
+    memset(result, 0, sizeof(term));
+
+    for (int i = 0; i < query->num_preds; i++) {
+        const struct inodecol_pred *pred = &query->preds[i];
+        eval_pred(ctx, pred, row, pred->new_term ? term : masks);
+        if (!pred->new_term) {
+            for (int w = 0; w < CHUNK_WORDS; w++) {
+                term[w] &= masks[w];
+            }
+        }
+        if (i + 1 == query->num_preds || query->preds[i + 1].new_term) {
+            for (int w = 0; w < CHUNK_WORDS; w++) {
+                result[w] |= term[w];
+            }
+        }
+    }
+
+    /* NOTE: The padding after the last inode never matches */
+    uint32_t num_rows = ctx->ic->num_rows;
+    if (row + CHUNK_ROWS > num_rows) {
+        for (int w = 0; w < CHUNK_WORDS; w++) {
+            size_t first = row + (size_t) w * 64;
+            if (first >= num_rows) {
+                result[w] = 0;
+            } else if (num_rows - first < 64) {
+                result[w] &= ((uint64_t) 1 << (num_rows - first)) - 1;
+            }
+        }
+    }
+}
+
+/* Return a bitmap with bit i set if inode i + 1 matches the query, or NULL
+ * on error
+ */
+uint64_t *inodecol_filter(struct inodecol *ic, const struct inodecol_query *query,
+        struct pool *pool) {
+    size_t num_chunks = ((size_t) ic->num_rows + CHUNK_ROWS - 1) / CHUNK_ROWS;
+    if (num_chunks == 0) {
+        num_chunks = 1;
+    }
+
+    struct filter_ctx ctx;
+    ctx.ic = ic;
+    ctx.query = query;
+    ctx.matches = malloc(num_chunks * CHUNK_WORDS * sizeof(uint64_t));
+    if (ctx.matches == NULL) {
+        return NULL;
+    }
+    ctx.use_avx2 = 0;
+#ifdef HAVE_AVX2_PATH
+    ctx.use_avx2 = have_avx2();
+#endif
+
+    pool_for(pool, num_chunks, filter_chunk, &ctx);
+    return ctx.matches;
+}
@@ -0,0 +1,68 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef INODECOL_H
+#define INODECOL_H
+
+#include <stdint.h>
+#include "fs.h"
+#include "pool.h"
+
+/* Inode column store and filter queries (--where).
+ *
+ * The inode tables are decoded once into one array per field, indexed by
+ * inode number - 1, so a query reads only the fields it tests. A query is
+ * a disjunction of conjunctions of comparisons:
+ *
+ *     mtime>1500000000 && uid==1000 || links==0 && mode!=0
+ *
+ * Fields are mode (the whole i_mode, file type included), uid, gid, links,
+ * size, ctime, mtime and atime. Operators are ==, !=, <, <=, > and >=, and
+ * values are unsigned decimal, octal (leading 0) or hexadecimal (0x)
+ * numbers. Every comparison is evaluated over 64 inodes at a time into a
+ * bit mask, with AVX2 where available.
+ */
+
+enum inodecol_field {
+    INODECOL_MODE,
+    INODECOL_UID,
+    INODECOL_GID,
+    INODECOL_LINKS,
+    INODECOL_CTIME,
+    INODECOL_MTIME,
+    INODECOL_ATIME,
+    INODECOL_NUM_U32,           /* Fields before this one are 32 bits wide */
+    INODECOL_SIZE = INODECOL_NUM_U32
+};
+
+#define INODECOL_MAX_PREDS 32
+
+struct inodecol_pred {
+    int field;
+    int op;
+    uint64_t value;
+    int new_term;               /* First comparison after a || */
+};
+
+struct inodecol_query {
+    struct inodecol_pred preds[INODECOL_MAX_PREDS];
+    int num_preds;
+};
+
+struct inodecol {
+    struct fs *fs;
+    uint32_t num_rows;          /* Inodes of every group's inode table */
+    uint32_t *u32[INODECOL_NUM_U32];
+    uint64_t *size;
+};
+
+int inodecol_parse(struct inodecol_query *query, const char *expr);
+
+int inodecol_load(struct inodecol *ic, struct fs *fs, struct pool *pool);
+void inodecol_free(struct inodecol *ic);
+uint64_t *inodecol_filter(struct inodecol *ic, const struct inodecol_query *query,
+        struct pool *pool);
+
+#endif
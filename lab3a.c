@@ -10,23 +10,44 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <math.h>
-#include <time.h>
 #include <string.h>
+#include <stdint.h>
+#include <getopt.h>
 #include "ext2_fs.h"
-
-#define SUPER_BLOCK_OFFSET 1024
-
-/* We assume there is a single block group in the file system */
-
-int get_offset(int block_id, int block_size) {
-    /* NOTE: Blocks are indexed starting from 1.
-     * The initial block is reserved for the boot block.
-     */
-    int offset = SUPER_BLOCK_OFFSET + (block_id - 1) * block_size;
-
-    return offset;
+#include "image.h"
+#include "fs.h"
+#include "pool.h"
+#include "outbuf.h"
+#include "timefmt.h"
+#include "check.h"
+#include "pathidx.h"
+#include "revmap.h"
+#include "prefetch.h"
+#include "ext2scan.h"
+#include "stats.h"
+#include "incr.h"
+#include "colfmt.h"
+#include "inodecol.h"
+#include "htree.h"
+#include "blkhash.h"
+#include "serve.h"
+#include "batch.h"
+
+/* Append a comma followed by a decimal field */
+static inline void put_field(struct outbuf *out, uint64_t v) {
+    outbuf_put_char(out, ',');
+    outbuf_put_u64(out, v);
 }
 
+/* Destination of the SUPERBLOCK and GROUP records: the output for CSV or
+the columns of a segment for --format=binary
+ */
+struct summary_ctx {
+    struct outbuf *out;
+    struct outbuf *cols;
+    struct fs *fs;
+};
+
 /* Print summary of superblock:
  * SUPERBLOCK
  * total number of blocks (decimal)
@@ -37,26 +58,28 @@ int get_offset(int block_id, int block_size) {
  * i-nodes per group (decimal)
  * first non-reserved i-node (decimal)
  *
- * Return 0 on success, -1 on error
+ * NOTE: fs_open has already checked the magic number
  */
-int print_superblock_summary(struct ext2_super_block *sb) {
-    if (sb->s_magic != EXT2_SUPER_MAGIC) {
-        return -1;
-    }
-
-    int num_blocks = sb->s_blocks_count;
-    int num_inodes = sb->s_inodes_count;
-    int block_size = EXT2_MIN_BLOCK_SIZE << sb->s_log_block_size;
-    int inode_size = sb->s_inode_size;
-    int blocks_per_group = sb->s_blocks_per_group;
-    int inodes_per_group = sb->s_inodes_per_group;
-    int first_nr_inode = sb->s_first_ino;
-
-    printf("SUPERBLOCK,%d,%d,%d,%d,%d,%d,%d\n",
-            num_blocks, num_inodes, block_size, inode_size,
-            blocks_per_group, inodes_per_group, first_nr_inode);
-
-    return 0;
+static void print_superblock_summary(void *arg, const struct ext2_super_block *sb) {
+    struct summary_ctx *ctx = arg;
+    struct outbuf *out = ctx->out;
+    uint32_t num_blocks = sb->s_blocks_count;
+    uint32_t num_inodes = sb->s_inodes_count;
+    uint32_t block_size = EXT2_MIN_BLOCK_SIZE << sb->s_log_block_size;
+    uint32_t inode_size = sb->s_inode_size;
+    uint32_t blocks_per_group = sb->s_blocks_per_group;
+    uint32_t inodes_per_group = sb->s_inodes_per_group;
+    uint32_t first_nr_inode = sb->s_first_ino;
+
+    outbuf_put_str(out, "SUPERBLOCK");
+    put_field(out, num_blocks);
+    put_field(out, num_inodes);
+    put_field(out, block_size);
+    put_field(out, inode_size);
+    put_field(out, blocks_per_group);
+    put_field(out, inodes_per_group);
+    put_field(out, first_nr_inode);
+    outbuf_put_char(out, '\n');
 }
 
 /* Print summary of each group:
@@ -70,94 +93,321 @@ int print_superblock_summary(struct ext2_super_block *sb) {
  * block number of free i-node bitmap for this group (decimal)
  * block number of first block of i-nodes in this group (decimal)
  */
-void print_group_summary(struct ext2_super_block *sb, struct ext2_group_desc *grp) {
-   int group_num;
-   int blocks_in_group;
-   int inodes_in_group;
-   int num_free_blocks;
-   int num_free_inodes;
-   int free_block_bitmap;
-   int free_inode_bitmap;
-   int first_inode_block;
+static void print_group_summary(void *arg, uint32_t group, const struct ext2_group_desc *grp) {
+   struct summary_ctx *ctx = arg;
+   struct outbuf *out = ctx->out;
+   struct fs *fs = ctx->fs;
+   uint32_t group_num;
+   uint32_t blocks_in_group;
+   uint32_t inodes_in_group;
+   uint32_t num_free_blocks;
+   uint32_t num_free_inodes;
+   uint32_t free_block_bitmap;
+   uint32_t free_inode_bitmap;
+   uint32_t first_inode_block;
 
    /* NOTE: Number of blocks/inodes on last block may not be the same
     * as the number in previous blocks for systems with multiple
     * cylinder groups
     */
 
-   group_num = 0;
-   blocks_in_group = sb->s_blocks_count;
-   inodes_in_group = sb->s_inodes_count;
+   group_num = group;
+   blocks_in_group = fs_group_blocks(fs, group);
+   inodes_in_group = fs_group_inodes(fs, group);
    num_free_blocks = grp->bg_free_blocks_count;
    num_free_inodes = grp->bg_free_inodes_count;
    free_block_bitmap = grp->bg_block_bitmap;
    free_inode_bitmap = grp->bg_inode_bitmap;
    first_inode_block = grp->bg_inode_table;
 
-   printf("GROUP,%d,%d,%d,%d,%d,%d,%d,%d\n",
-           group_num, blocks_in_group, inodes_in_group,
-           num_free_blocks, num_free_inodes, free_block_bitmap,
-           free_inode_bitmap, first_inode_block);
+   outbuf_put_str(out, "GROUP");
+   put_field(out, group_num);
+   put_field(out, blocks_in_group);
+   put_field(out, inodes_in_group);
+   put_field(out, num_free_blocks);
+   put_field(out, num_free_inodes);
+   put_field(out, free_block_bitmap);
+   put_field(out, free_inode_bitmap);
+   put_field(out, first_inode_block);
+   outbuf_put_char(out, '\n');
 }
-/* Print free block entries:
- * BFREE
- * number of the free block (decimal)
+
+/* Free bitmap entries are either printed one per object or, with
+ * --ranges, as one record per run of free objects.
  */
-void print_free_block_entries(int img_fd, struct ext2_super_block *sb,
-        struct ext2_group_desc *grp) {
-    int block_bitmap;
-    int block_size = EXT2_MIN_BLOCK_SIZE << sb->s_log_block_size;
+static int output_ranges = 0;
 
-    block_bitmap = grp->bg_block_bitmap;
+/* With --check the traversal feeds the consistency checker instead of
+ * printing records
+ */
+static struct check *checker = NULL;
 
-    unsigned char *bitmap = malloc(block_size);
-    int offset = get_offset(block_bitmap, block_size);
-    pread(img_fd, bitmap, block_size, offset);
+/* Without --check and --resolve every record is printed */
+static int print_records = 1;
 
-    for (int j = 0; j < block_size; j++) {
-        for (int i = 0; i < 8; i++) {
-            int is_allocated = bitmap[j] & (1 << i);
-            if (!is_allocated) {
-                int block_id = (j * 8) + (i + 1);
-                printf("BFREE,%d\n", block_id);
-            }
-        }
+/* Path index built from the directory entries, with --paths */
+static struct pathidx *path_index = NULL;
+
+/* Block ownership reverse map, with --revmap */
+static struct revmap *block_map = NULL;
+
+/* Checksums of file data blocks, with --hash-blocks */
+static struct blkhash *block_hashes = NULL;
+
+/* Phase timings and record counts, with --stats */
+static struct stats *run_stats = NULL;
+
+/* Records of unchanged groups from the last run, with --incremental */
+static struct incr *incremental = NULL;
+
+/* Output formats (--format) */
+enum output_format {
+    FORMAT_CSV,
+    FORMAT_BINARY
+};
+
+static enum output_format output_format = FORMAT_CSV;
+
+/* Output streams of a group. Each record type gets its own stream so that
+ * a single traversal can emit all of them while the final output keeps one
+ * record type after the other.
+ */
+enum output_stream {
+    OUT_BFREE,
+    OUT_IFREE,
+    OUT_INODE,
+    OUT_DIRENT,
+    OUT_INDIRECT,
+    OUT_CHECK_BLOCK,        /* Invalid and reserved block references */
+    OUT_CHECK_DIRENT,       /* Bad directory entries */
+    NUM_OUTPUT_STREAMS
+};
+
+static const char *stream_names[NUM_OUTPUT_STREAMS] = {
+    "BFREE", "IFREE", "INODE", "DIRENT", "INDIRECT", "CHECK_BLOCK", "CHECK_DIRENT"
+};
+
+/* Columns of --format=binary, which take the place of the streams. The
+ * tables match the CSV records field for field, except that INODE always
+ * carries all 15 block pointers and DIRENT names go to a string heap.
+ */
+enum column {
+    COL_SB_BLOCKS,
+    COL_SB_INODES,
+    COL_SB_BLOCK_SIZE,
+    COL_SB_INODE_SIZE,
+    COL_SB_BLOCKS_PER_GROUP,
+    COL_SB_INODES_PER_GROUP,
+    COL_SB_FIRST_INO,
+    COL_GROUP,
+    COL_GROUP_BLOCKS,
+    COL_GROUP_INODES,
+    COL_GROUP_FREE_BLOCKS,
+    COL_GROUP_FREE_INODES,
+    COL_GROUP_BLOCK_BITMAP,
+    COL_GROUP_INODE_BITMAP,
+    COL_GROUP_INODE_TABLE,
+    COL_BFREE,
+    COL_BFREE_FIRST,
+    COL_BFREE_LAST,
+    COL_IFREE,
+    COL_IFREE_FIRST,
+    COL_IFREE_LAST,
+    COL_INODE,
+    COL_INODE_TYPE,
+    COL_INODE_MODE,
+    COL_INODE_UID,
+    COL_INODE_GID,
+    COL_INODE_LINKS,
+    COL_INODE_CTIME,
+    COL_INODE_MTIME,
+    COL_INODE_ATIME,
+    COL_INODE_SIZE,
+    COL_INODE_BLOCKS,
+    COL_INODE_I_BLOCK,
+    COL_DIRENT_PARENT,
+    COL_DIRENT_OFFSET,
+    COL_DIRENT_INODE,
+    COL_DIRENT_REC_LEN,
+    COL_DIRENT_NAME_LEN,
+    COL_DIRENT_NAME,            /* Lengths of the names while scanning */
+    COL_DIRENT_NAME_HEAP,
+    COL_INDIRECT_INODE,
+    COL_INDIRECT_LEVEL,
+    COL_INDIRECT_LBO,
+    COL_INDIRECT_BLOCK,
+    COL_INDIRECT_REF,
+    NUM_COLUMNS
+};
+
+struct column_def {
+    const char *table;
+    const char *name;
+    uint32_t type;
+    uint32_t width;
+    uint32_t count;
+};
+
+static const struct column_def column_defs[NUM_COLUMNS] = {
+    [COL_SB_BLOCKS] = {"SUPERBLOCK", "blocks_count", COLFMT_UINT, 4, 1},
+    [COL_SB_INODES] = {"SUPERBLOCK", "inodes_count", COLFMT_UINT, 4, 1},
+    [COL_SB_BLOCK_SIZE] = {"SUPERBLOCK", "block_size", COLFMT_UINT, 4, 1},
+    [COL_SB_INODE_SIZE] = {"SUPERBLOCK", "inode_size", COLFMT_UINT, 4, 1},
+    [COL_SB_BLOCKS_PER_GROUP] = {"SUPERBLOCK", "blocks_per_group", COLFMT_UINT, 4, 1},
+    [COL_SB_INODES_PER_GROUP] = {"SUPERBLOCK", "inodes_per_group", COLFMT_UINT, 4, 1},
+    [COL_SB_FIRST_INO] = {"SUPERBLOCK", "first_ino", COLFMT_UINT, 4, 1},
+    [COL_GROUP] = {"GROUP", "group", COLFMT_UINT, 4, 1},
+    [COL_GROUP_BLOCKS] = {"GROUP", "blocks", COLFMT_UINT, 4, 1},
+    [COL_GROUP_INODES] = {"GROUP", "inodes", COLFMT_UINT, 4, 1},
+    [COL_GROUP_FREE_BLOCKS] = {"GROUP", "free_blocks", COLFMT_UINT, 4, 1},
+    [COL_GROUP_FREE_INODES] = {"GROUP", "free_inodes", COLFMT_UINT, 4, 1},
+    [COL_GROUP_BLOCK_BITMAP] = {"GROUP", "block_bitmap", COLFMT_UINT, 4, 1},
+    [COL_GROUP_INODE_BITMAP] = {"GROUP", "inode_bitmap", COLFMT_UINT, 4, 1},
+    [COL_GROUP_INODE_TABLE] = {"GROUP", "inode_table", COLFMT_UINT, 4, 1},
+    [COL_BFREE] = {"BFREE", "block", COLFMT_UINT, 4, 1},
+    [COL_BFREE_FIRST] = {"BFREE_RANGE", "first", COLFMT_UINT, 4, 1},
+    [COL_BFREE_LAST] = {"BFREE_RANGE", "last", COLFMT_UINT, 4, 1},
+    [COL_IFREE] = {"IFREE", "inode", COLFMT_UINT, 4, 1},
+    [COL_IFREE_FIRST] = {"IFREE_RANGE", "first", COLFMT_UINT, 4, 1},
+    [COL_IFREE_LAST] = {"IFREE_RANGE", "last", COLFMT_UINT, 4, 1},
+    [COL_INODE] = {"INODE", "inode", COLFMT_UINT, 4, 1},
+    [COL_INODE_TYPE] = {"INODE", "type", COLFMT_CHAR, 1, 1},
+    [COL_INODE_MODE] = {"INODE", "mode", COLFMT_UINT, 2, 1},
+    [COL_INODE_UID] = {"INODE", "uid", COLFMT_UINT, 2, 1},
+    [COL_INODE_GID] = {"INODE", "gid", COLFMT_UINT, 2, 1},
+    [COL_INODE_LINKS] = {"INODE", "links", COLFMT_UINT, 2, 1},
+    [COL_INODE_CTIME] = {"INODE", "ctime", COLFMT_UINT, 4, 1},
+    [COL_INODE_MTIME] = {"INODE", "mtime", COLFMT_UINT, 4, 1},
+    [COL_INODE_ATIME] = {"INODE", "atime", COLFMT_UINT, 4, 1},
+    [COL_INODE_SIZE] = {"INODE", "size", COLFMT_UINT, 8, 1},
+    [COL_INODE_BLOCKS] = {"INODE", "blocks", COLFMT_UINT, 4, 1},
+    [COL_INODE_I_BLOCK] = {"INODE", "i_block", COLFMT_UINT, 4, EXT2_N_BLOCKS},
+    [COL_DIRENT_PARENT] = {"DIRENT", "parent", COLFMT_UINT, 4, 1},
+    [COL_DIRENT_OFFSET] = {"DIRENT", "offset", COLFMT_UINT, 8, 1},
+    [COL_DIRENT_INODE] = {"DIRENT", "inode", COLFMT_UINT, 4, 1},
+    [COL_DIRENT_REC_LEN] = {"DIRENT", "rec_len", COLFMT_UINT, 2, 1},
+    [COL_DIRENT_NAME_LEN] = {"DIRENT", "name_len", COLFMT_UINT, 2, 1},
+    [COL_DIRENT_NAME] = {"DIRENT", "name", COLFMT_OFFSETS, 8, 1},
+    [COL_DIRENT_NAME_HEAP] = {"DIRENT", "name_heap", COLFMT_HEAP, 1, 1},
+    [COL_INDIRECT_INODE] = {"INDIRECT", "inode", COLFMT_UINT, 4, 1},
+    [COL_INDIRECT_LEVEL] = {"INDIRECT", "level", COLFMT_UINT, 1, 1},
+    [COL_INDIRECT_LBO] = {"INDIRECT", "lbo", COLFMT_UINT, 8, 1},
+    [COL_INDIRECT_BLOCK] = {"INDIRECT", "block", COLFMT_UINT, 4, 1},
+    [COL_INDIRECT_REF] = {"INDIRECT", "ref", COLFMT_UINT, 4, 1},
+};
+
+/* Buffers per segment: NUM_OUTPUT_STREAMS, or NUM_COLUMNS in binary */
+static int num_streams = NUM_OUTPUT_STREAMS;
+
+/* A piece of the output of a group, with one buffer per stream. Segments
+ * are the strands of the scan.
+ *
+ * The segments of all groups form a single chain in output order. When the
+ * scanner hands part of a walk to another worker, it splits its segment:
+ * the handed off work gets a new segment right after the current one and
+ * the walk carries on in another segment after that. Concatenating each
+ * stream along the chain then gives the same output as a serial run.
+ */
+struct segment {
+    struct segment *next;
+    struct outbuf outs[];
+};
+
+/* Inode flag for the scanner: add directory entries to the path index */
+#define WALK_INDEX_ENTRIES 0x100
+
+static struct segment *new_segment(struct segment *next) {
+    struct segment *seg = malloc(sizeof(*seg) + num_streams * sizeof(struct outbuf));
+    if (seg == NULL) {
+        fprintf(stderr, "Unable to allocate output buffer!\n");
+        exit(2);
+    }
+    for (int s = 0; s < num_streams; s++) {
+        outbuf_init(&seg->outs[s], -1, 0);
     }
+    seg->next = next;
+    return seg;
+}
 
-    free(bitmap);
+/* Split the segment of a walk. Return the segment for the work being
+ * handed off; the walk itself continues in the segment after it.
+ */
+static void *split_output(struct ext2scan_ctx *ctx) {
+    struct segment *seg = ctx->strand;
+    struct segment *cont = new_segment(seg->next);
+    struct segment *child = new_segment(cont);
+    seg->next = child;
+    ctx->strand = cont;
+    return child;
 }
 
-/* Print free inode entries
- * IFREE
- * number of the free I-node (decimal)
+static struct outbuf *walk_out(struct ext2scan_ctx *ctx, enum output_stream s) {
+    struct segment *seg = ctx->strand;
+    return &seg->outs[s];
+}
+
+/* Every group starts out with its own head segment, and unchanged groups
+ * are left out with --incremental
  */
-void print_free_inode_entries(int img_fd, struct ext2_super_block *sb,
-        struct ext2_group_desc *grp) {
-    int inode_bitmap;
-    //int inodes_in_group;
-    int block_size = EXT2_MIN_BLOCK_SIZE << sb->s_log_block_size;
-
-    inode_bitmap = grp->bg_inode_bitmap;
-    //inodes_in_group = sb->s_inodes_count;
-
-    unsigned char *bitmap = malloc(block_size);
-    int offset = get_offset(inode_bitmap, block_size);
-    pread(img_fd, bitmap, block_size, offset);
-
-    for (int j = 0; j < block_size; j++) {
-        for (int i = 0; i < 8; i++) {
-            int is_allocated = bitmap[j] & (1 << i);
-            if (!is_allocated) {
-                int inode_id = (j * 8) + (i + 1);
-                printf("IFREE,%d\n", inode_id);
-            }
-        }
+static int begin_group(struct ext2scan_ctx *ctx) {
+    struct segment **heads = ctx->arg;
+    ctx->strand = heads[ctx->group];
+    return !(incremental && incr_cached(incremental, ctx->group));
+}
+
+static void print_free_run(struct outbuf *out, const char *tag, uint32_t id, uint32_t len) {
+    if (output_ranges) {
+        outbuf_put_str(out, tag);
+        outbuf_put_str(out, "_RANGE");
+        put_field(out, id);
+        put_field(out, id + len - 1);
+        outbuf_put_char(out, '\n');
+        return;
     }
 
-    free(bitmap);
+    for (uint32_t i = 0; i < len; i++) {
+        outbuf_put_str(out, tag);
+        put_field(out, id + i);
+        outbuf_put_char(out, '\n');
+    }
 }
 
+/* Print free block entries:
+ * BFREE
+ * number of the free block (decimal)
+ *
+ * or, with --ranges:
+ * BFREE_RANGE
+ * first free block of the run (decimal)
+ * last free block of the run (decimal)
+ */
+static void print_free_blocks(struct ext2scan_ctx *ctx, uint32_t first, uint32_t count) {
+    print_free_run(walk_out(ctx, OUT_BFREE), "BFREE", first, count);
+}
+
+/* Print free inode entries
+ * IFREE
+ * number of the free I-node (decimal)
+ *
+ * or, with --ranges:
+ * IFREE_RANGE
+ * first free I-node of the run (decimal)
+ * last free I-node of the run (decimal)
+ */
+static void print_free_inodes(struct ext2scan_ctx *ctx, uint32_t first, uint32_t count) {
+    print_free_run(walk_out(ctx, OUT_IFREE), "IFREE", first, count);
+}
 
+/* File size in bytes. Regular files on large_file file systems keep the
+ * upper 32 bits in i_size_high.
+ */
+static inline uint64_t inode_file_size(const struct ext2_inode *inode_entry) {
+    uint64_t size = inode_entry->i_size;
+    if (S_ISREG(inode_entry->i_mode)) {
+        size |= (uint64_t) inode_entry->i_size_high << 32;
+    }
+    return size;
+}
 /* Print inode summary
  * INODE
  * inode number (decimal)
@@ -172,144 +422,212 @@ void print_free_inode_entries(int img_fd, struct ext2_super_block *sb,
  * file size (decimal)
  * number of (512 byte) blocks of disk space (decimal) taken up by this file
  */
-void print_inode_summary(int img_fd, struct ext2_super_block *sb,
-        struct ext2_group_desc *grp) {
-    int inode_table;
-    struct ext2_inode table[sb->s_inodes_count];
-    int block_size = EXT2_MIN_BLOCK_SIZE << sb->s_log_block_size;
-    int inodes_in_group;
-
-    inode_table = grp->bg_inode_table;
-    inodes_in_group = sb->s_inodes_count;
-
-    int table_offset = get_offset(inode_table, block_size);
-    pread(img_fd, table, sizeof(table), table_offset);
-
-    for (int j = 0; j < inodes_in_group; j++) {
-        if (table[j].i_mode && table[j].i_links_count) {
-            int inode_id = j + 1;
-            int file_type_mode = table[j].i_mode & 0xF000;
-            char file_type = '?';
-            switch (file_type_mode) {
-                case 0x8000:
-                    file_type = 'f';
-                    break;
-                case 0x4000:
-                    file_type = 'd';
-                    break;
-                case 0xA000:
-                    file_type = 's';
-                    break;
-                default:
-                    file_type = '?';
-                    break;
-            }
-            int mode = table[j].i_mode & 0x0FFF;
-            int owner = table[j].i_uid;
-            int group = table[j].i_gid;
-            int link_count = table[j].i_links_count;
-
-            struct tm *c_time_info;
-            time_t c_time = table[j].i_ctime;
-            char c_time_buf[64];
-            c_time_info = gmtime(&c_time);
-            strftime(c_time_buf, 64, "%x %X", c_time_info);
-
-            struct tm *m_time_info;
-            time_t m_time = table[j].i_mtime;
-            char m_time_buf[64];
-            m_time_info = gmtime(&m_time);
-            strftime(m_time_buf, 64, "%x %X", m_time_info);
-
-            struct tm *a_time_info;
-            time_t a_time = table[j].i_atime;
-            char a_time_buf[64];
-            a_time_info = gmtime(&a_time);
-            strftime(a_time_buf, 64, "%x %X", a_time_info);
-
-            int file_size = table[j].i_size;
-            int num_blocks = table[j].i_blocks;
-
-            printf("INODE,%d,%c,%o,%d,%d,%d,%s,%s,%s,%d,%d",
-                    inode_id, file_type, mode, owner, group, link_count,
-                    c_time_buf, m_time_buf, a_time_buf, file_size, num_blocks);
-
-            if (file_type == 'f' || file_type == 'd' || file_type == 's') {
-                if (file_type == 's' && file_size < 60) {
-                    /* NOTE: This is value does not represent a valid block but the first
-                     * four bytes of the file name the symlink points to. Print this to
-                     * match the trivial.csv format.
-                     */
-                    printf(",%d", table[j].i_block[0]);
-                }
+void print_inode_summary(struct outbuf *out, uint32_t inode_id,
+        const struct ext2_inode *inode_entry) {
+    int file_type_mode = inode_entry->i_mode & 0xF000;
+    char file_type = '?';
+    switch (file_type_mode) {
+        case 0x8000:
+            file_type = 'f';
+            break;
+        case 0x4000:
+            file_type = 'd';
+            break;
+        case 0xA000:
+            file_type = 's';
+            break;
+        default:
+            file_type = '?';
+            break;
+    }
+    int mode = inode_entry->i_mode & 0x0FFF;
+    int owner = inode_entry->i_uid;
+    int group = inode_entry->i_gid;
+    int link_count = inode_entry->i_links_count;
+
+    char c_time_buf[TIMEFMT_LEN + 1];
+    format_gmt(inode_entry->i_ctime, c_time_buf);
+
+    char m_time_buf[TIMEFMT_LEN + 1];
+    format_gmt(inode_entry->i_mtime, m_time_buf);
+
+    char a_time_buf[TIMEFMT_LEN + 1];
+    format_gmt(inode_entry->i_atime, a_time_buf);
+
+    uint64_t file_size = inode_file_size(inode_entry);
+    uint32_t num_blocks = inode_entry->i_blocks;
+
+    outbuf_put_str(out, "INODE");
+    put_field(out, inode_id);
+    outbuf_put_char(out, ',');
+    outbuf_put_char(out, file_type);
+    outbuf_put_char(out, ',');
+    outbuf_put_octal(out, mode);
+    put_field(out, owner);
+    put_field(out, group);
+    put_field(out, link_count);
+    outbuf_put_char(out, ',');
+    outbuf_put_mem(out, c_time_buf, TIMEFMT_LEN);
+    outbuf_put_char(out, ',');
+    outbuf_put_mem(out, m_time_buf, TIMEFMT_LEN);
+    outbuf_put_char(out, ',');
+    outbuf_put_mem(out, a_time_buf, TIMEFMT_LEN);
+    put_field(out, file_size);
+    put_field(out, num_blocks);
+
+    if (file_type == 'f' || file_type == 'd' || file_type == 's') {
+        if (file_type == 's' && file_size < 60) {
+            /* NOTE: This is value does not represent a valid block but the first
+             * four bytes of the file name the symlink points to. Print this to
+             * match the trivial.csv format.
+             */
+            put_field(out, inode_entry->i_block[0]);
+        }
 
-                else {
-                    for (int k = 0; k < 15; k++) {
-                        int ptr = table[j].i_block[k];
-                        printf(",%d", ptr);
-                    }
-                }
+        else {
+            for (int k = 0; k < 15; k++) {
+                uint32_t ptr = inode_entry->i_block[k];
+                put_field(out, ptr);
             }
-
-            printf("\n");
         }
     }
-}
 
-/* Iterate through directory entries of a data block */
-void scan_dir(int img_fd, int block_id, int block_size, int inode_id, int lbo) {
-    char block[block_size];
-    int offset = get_offset(block_id, block_size);
-    pread(img_fd, block, block_size, offset);
+    outbuf_put_char(out, '\n');
+}
 
-    struct ext2_dir_entry *dirent = (struct ext2_dir_entry *) block;
-    int size = 0;
-    while (size < block_size) {
-        if (dirent->inode != 0) {
-            int name_len = dirent->name_len;
-            char name[name_len + 1];
-            memcpy(name, dirent->name, name_len);
-            name[name_len] = '\0';
+/* Append a value to a binary column */
+static inline void put_col(struct outbuf *cols, enum column c, const void *v, size_t n) {
+    outbuf_put_mem(&cols[c], v, n);
+}
 
-            printf("DIRENT,%d,%d,%d,%d,%d,'%s'\n",
-                    inode_id, size + lbo * block_size, dirent->inode,
-                    dirent->rec_len, name_len, name);
-            size += dirent->rec_len;
-        }
+static inline void put_col_u32(struct outbuf *cols, enum column c, uint32_t v) {
+    put_col(cols, c, &v, sizeof(v));
+}
 
-        dirent = (void *) dirent + dirent->rec_len;
+static inline void put_col_u16(struct outbuf *cols, enum column c, uint16_t v) {
+    put_col(cols, c, &v, sizeof(v));
+}
 
-        if (dirent->rec_len == 0) {
-            break;
-        }
+static inline void put_col_u64(struct outbuf *cols, enum column c, uint64_t v) {
+    put_col(cols, c, &v, sizeof(v));
+}
 
-    }
+static struct outbuf *walk_cols(struct ext2scan_ctx *ctx) {
+    struct segment *seg = ctx->strand;
+    return seg->outs;
+}
 
+/* SUPERBLOCK and GROUP rows of --format=binary */
+static void put_superblock_columns(void *arg, const struct ext2_super_block *sb) {
+    struct summary_ctx *ctx = arg;
+    struct outbuf *cols = ctx->cols;
+
+    put_col_u32(cols, COL_SB_BLOCKS, sb->s_blocks_count);
+    put_col_u32(cols, COL_SB_INODES, sb->s_inodes_count);
+    put_col_u32(cols, COL_SB_BLOCK_SIZE, EXT2_MIN_BLOCK_SIZE << sb->s_log_block_size);
+    put_col_u32(cols, COL_SB_INODE_SIZE, sb->s_inode_size);
+    put_col_u32(cols, COL_SB_BLOCKS_PER_GROUP, sb->s_blocks_per_group);
+    put_col_u32(cols, COL_SB_INODES_PER_GROUP, sb->s_inodes_per_group);
+    put_col_u32(cols, COL_SB_FIRST_INO, sb->s_first_ino);
 }
 
-/* Visit indirect directory entries */
-void visit_indirect_dirents(int level, int block_id, int block_size, int num_entries,
-        int img_fd, int inode_id, int lbo) {
-    char block[block_size];
-    int offset = get_offset(block_id, block_size);
-    pread(img_fd, block, block_size, offset);
+static void put_group_columns(void *arg, uint32_t group, const struct ext2_group_desc *grp) {
+    struct summary_ctx *ctx = arg;
+    struct outbuf *cols = ctx->cols;
+
+    put_col_u32(cols, COL_GROUP, group);
+    put_col_u32(cols, COL_GROUP_BLOCKS, fs_group_blocks(ctx->fs, group));
+    put_col_u32(cols, COL_GROUP_INODES, fs_group_inodes(ctx->fs, group));
+    put_col_u32(cols, COL_GROUP_FREE_BLOCKS, grp->bg_free_blocks_count);
+    put_col_u32(cols, COL_GROUP_FREE_INODES, grp->bg_free_inodes_count);
+    put_col_u32(cols, COL_GROUP_BLOCK_BITMAP, grp->bg_block_bitmap);
+    put_col_u32(cols, COL_GROUP_INODE_BITMAP, grp->bg_inode_bitmap);
+    put_col_u32(cols, COL_GROUP_INODE_TABLE, grp->bg_inode_table);
+}
 
-    int *ptr = (int *) block;
+/* One row per free object, or per run of them with --ranges */
+static void put_free_run_columns(struct outbuf *cols, enum column single, uint32_t id,
+        uint32_t len) {
+    if (output_ranges) {
+        put_col_u32(cols, single + 1, id);
+        put_col_u32(cols, single + 2, id + len - 1);
+        return;
+    }
 
-    if (level == 1) {
-        for (int i = 0; i < num_entries; i++) {
-            scan_dir(img_fd, *ptr, block_size, inode_id, lbo + i);
-            ptr++;
-        }   
+    uint32_t *p = (uint32_t *) outbuf_reserve(&cols[single], len * sizeof(uint32_t));
+    if (p == NULL) {
         return;
     }
-    
-    for (int i = 0; i < num_entries; i++) {
-        visit_indirect_dirents(level - 1, *ptr, block_size, num_entries,
-                img_fd, inode_id, lbo);
-        lbo += num_entries;
-        ptr++;
+    for (uint32_t i = 0; i < len; i++) {
+        p[i] = id + i;
     }
+    cols[single].len += len * sizeof(uint32_t);
+}
+
+static void put_free_block_columns(struct ext2scan_ctx *ctx, uint32_t first, uint32_t count) {
+    put_free_run_columns(walk_cols(ctx), COL_BFREE, first, count);
+}
+
+static void put_free_inode_columns(struct ext2scan_ctx *ctx, uint32_t first, uint32_t count) {
+    put_free_run_columns(walk_cols(ctx), COL_IFREE, first, count);
+}
+
+static void put_inode_columns(struct outbuf *cols, uint32_t inode_id,
+        const struct ext2_inode *inode_entry) {
+    char file_type = '?';
+    switch (inode_entry->i_mode & 0xF000) {
+        case 0x8000:
+            file_type = 'f';
+            break;
+        case 0x4000:
+            file_type = 'd';
+            break;
+        case 0xA000:
+            file_type = 's';
+            break;
+    }
+
+    put_col_u32(cols, COL_INODE, inode_id);
+    put_col(cols, COL_INODE_TYPE, &file_type, 1);
+    put_col_u16(cols, COL_INODE_MODE, inode_entry->i_mode & 0x0FFF);
+    put_col_u16(cols, COL_INODE_UID, inode_entry->i_uid);
+    put_col_u16(cols, COL_INODE_GID, inode_entry->i_gid);
+    put_col_u16(cols, COL_INODE_LINKS, inode_entry->i_links_count);
+    put_col_u32(cols, COL_INODE_CTIME, inode_entry->i_ctime);
+    put_col_u32(cols, COL_INODE_MTIME, inode_entry->i_mtime);
+    put_col_u32(cols, COL_INODE_ATIME, inode_entry->i_atime);
+    put_col_u64(cols, COL_INODE_SIZE, inode_file_size(inode_entry));
+    put_col_u32(cols, COL_INODE_BLOCKS, inode_entry->i_blocks);
+    put_col(cols, COL_INODE_I_BLOCK, inode_entry->i_block, sizeof(inode_entry->i_block));
+}
+
+/* NOTE: The name column only gets the length of each name here; offsets
+ * into the heap are computed when the columns are written, so segments
+ * (and the incremental index) never depend on what precedes them
+ */
+static void put_dirent_columns(struct outbuf *cols, uint32_t dir_id, uint64_t offset,
+        const struct ext2_dir_entry *dirent, int name_len) {
+    uint32_t len = strnlen(dirent->name, name_len);
+
+    put_col_u32(cols, COL_DIRENT_PARENT, dir_id);
+    put_col_u64(cols, COL_DIRENT_OFFSET, offset);
+    put_col_u32(cols, COL_DIRENT_INODE, dirent->inode);
+    put_col_u16(cols, COL_DIRENT_REC_LEN, dirent->rec_len);
+    put_col_u16(cols, COL_DIRENT_NAME_LEN, name_len);
+    put_col_u32(cols, COL_DIRENT_NAME, len);
+    put_col(cols, COL_DIRENT_NAME_HEAP, dirent->name, len);
+}
+
+static void put_indirect_columns(struct ext2scan_ctx *ctx, int level, uint64_t lbo,
+        uint32_t block_id, uint32_t ref_id) {
+    struct outbuf *cols = walk_cols(ctx);
+    uint8_t level8 = level;
+
+    put_col_u32(cols, COL_INDIRECT_INODE, ctx->inode_id);
+    put_col(cols, COL_INDIRECT_LEVEL, &level8, 1);
+    put_col_u64(cols, COL_INDIRECT_LBO, lbo);
+    put_col_u32(cols, COL_INDIRECT_BLOCK, block_id);
+    put_col_u32(cols, COL_INDIRECT_REF, ref_id);
 }
 
 /* Print directory entry summary:
@@ -321,181 +639,1316 @@ void visit_indirect_dirents(int level, int block_id, int block_size, int num_ent
  * name length (decimal)
  * name (string, surrounded by single-quotes). Don't worry about escaping, we promise there will be no single-quotes or commas in any of the file names.
  */
-void print_dir_entries(int img_fd, struct ext2_super_block *sb,
-        struct ext2_group_desc *grp) {
-    int inodes_in_group;
-    int inode_table;
-    struct ext2_inode table[sb->s_inodes_count];
-    int block_size = EXT2_MIN_BLOCK_SIZE << sb->s_log_block_size;
+static void print_dirent(struct outbuf *out, uint32_t dir_id, uint64_t offset,
+        const struct ext2_dir_entry *dirent, int name_len) {
+    outbuf_put_str(out, "DIRENT");
+    put_field(out, dir_id);
+    put_field(out, offset);
+    put_field(out, dirent->inode);
+    put_field(out, dirent->rec_len);
+    put_field(out, name_len);
+    outbuf_put_str(out, ",'");
+    outbuf_put_mem(out, dirent->name, strnlen(dirent->name, name_len));
+    outbuf_put_str(out, "'\n");
+}
 
-    /* Number of 32-bit block pointers in a block */
-    /* NOTE: block size is in bytes */
-    int num_entries = (block_size * 8) / 32;
+/* Print a directory entry, or hand it to the checker with --check */
+static void visit_dirent(struct ext2scan_ctx *ctx, uint64_t offset,
+        const struct ext2_dir_entry *dirent, int name_len) {
+    uint32_t inode_id = ctx->inode_id;
 
-    inode_table = grp->bg_inode_table;
-    inodes_in_group = sb->s_inodes_count;
+    if (ctx->flags & WALK_INDEX_ENTRIES) {
+        pathidx_add(path_index, ctx->worker, inode_id, offset, dirent->inode, dirent->name,
+                strnlen(dirent->name, name_len));
+    }
 
-    int table_offset = get_offset(inode_table, block_size);
-    pread(img_fd, table, sizeof(table), table_offset);
+    if (checker) {
+        check_dirent(checker, ctx->worker, walk_out(ctx, OUT_CHECK_DIRENT), inode_id,
+                dirent->inode, dirent->name, strnlen(dirent->name, name_len));
+    } else if (output_format == FORMAT_BINARY) {
+        put_dirent_columns(walk_cols(ctx), inode_id, offset, dirent, name_len);
+    } else if (print_records) {
+        print_dirent(walk_out(ctx, OUT_DIRENT), inode_id, offset, dirent, name_len);
+    }
+}
 
-    for (int j = 0; j < inodes_in_group; j++) {
-        int inode_id = j + 1; 
-        struct ext2_inode *inode_entry = &table[j];
-        if (S_ISDIR(inode_entry->i_mode)) {
-            int lbo = 0;
-            for (int k = 0; k < 15; k++) {
-                int ptr = inode_entry->i_block[k];
+/* Print indirect block references:
+ * INDIRECT
+ * I-node number of the owning file (decimal)
+ * (decimal) level of indirection for the block being scanned ... 1 for single indirect, 2 for double indirect, 3 for triple
+ * logical block offset (decimal) represented by the referenced block. If the referenced block is a data block, this is the logical block offset of that block within the file. If the referenced block is a single- or double-indirect block, this is the same as the logical offset of the first data block to which it refers.
+ * block number of the (1, 2, 3) indirect block being scanned (decimal) . . . not the highest level block (in the recursive scan), but the lower level block that contains the block reference reported by this entry.
+ * block number of the referenced block (decimal)
+ */
+static void print_indirect_ref(struct ext2scan_ctx *ctx, int level, uint64_t lbo,
+        uint32_t block_id, uint32_t ref_id) {
+    struct outbuf *out = walk_out(ctx, OUT_INDIRECT);
+    outbuf_put_str(out, "INDIRECT");
+    put_field(out, ctx->inode_id);
+    put_field(out, level);
+    put_field(out, lbo);
+    put_field(out, block_id);
+    put_field(out, ref_id);
+    outbuf_put_char(out, '\n');
+}
 
-                if (ptr == 0) {
-                    continue;
-                }
+/* Report a block reference of the inode being walked to the checker and
+ * the reverse map.
+ *
+ * Return 1 if the block may be read, 0 if the checker rejected it
+ */
+static int visit_ref(struct ext2scan_ctx *ctx, uint32_t block_id, uint64_t lbo, int level) {
+    if (checker && !check_block(checker, walk_out(ctx, OUT_CHECK_BLOCK), block_id,
+            ctx->inode_id, lbo, level)) {
+        return 0;
+    }
+    if (block_map) {
+        revmap_add(block_map, ctx->worker, ctx->inode_id, block_id, lbo);
+    }
+    if (block_hashes && level == 0) {
+        blkhash_add_block(block_hashes, ctx->worker, ctx->inode_id, ctx->size, block_id, lbo);
+    }
+    return 1;
+}
 
-                if (k < 12) {
-                    scan_dir(img_fd, ptr, block_size, inode_id, lbo);
-                    lbo++;
-                } if (k == 12) {
-                    visit_indirect_dirents(1, ptr, block_size, num_entries,
-                            img_fd, inode_id, lbo);
-                    lbo += num_entries;
-                } else if (k == 13) {
-                    visit_indirect_dirents(2, ptr, block_size, num_entries,
-                            img_fd, inode_id, lbo);
-                    lbo += num_entries * num_entries;
-                } else if (k == 14) {
-                    visit_indirect_dirents(3, ptr, block_size, num_entries,
-                            img_fd, inode_id, lbo);
-                    lbo += num_entries * num_entries * num_entries;
-                }
+/* Print the INODE record of an inode and decide how much of it the
+ * scanner has to walk
+ */
+static int visit_inode(struct ext2scan_ctx *ctx, uint32_t inode_id,
+        const struct ext2_inode *inode_entry) {
+    int allocated = inode_entry->i_mode && inode_entry->i_links_count;
+    if (path_index && allocated && S_ISDIR(inode_entry->i_mode)) {
+        pathidx_mark_dir(path_index, inode_id);
+    }
+
+    if (checker || block_map) {
+        /* NOTE: Only allocated inodes count as references to blocks */
+        if (!fs_inode_has_blocks(inode_entry)) {
+            return 0;
+        }
+    } else if (block_hashes) {
+        /* NOTE: Only the contents of regular files are hashed */
+        if (!S_ISREG(inode_entry->i_mode) || !fs_inode_has_blocks(inode_entry)) {
+            return 0;
+        }
+        blkhash_add_file(block_hashes, ctx->worker, inode_id, ctx->size);
+    } else if (print_records) {
+        if (allocated && output_format == FORMAT_BINARY) {
+            put_inode_columns(walk_cols(ctx), inode_id, inode_entry);
+        } else if (allocated) {
+            print_inode_summary(walk_out(ctx, OUT_INODE), inode_id, inode_entry);
+        }
+
+        if (!S_ISDIR(inode_entry->i_mode) && !S_ISREG(inode_entry->i_mode)) {
+            return 0;
+        }
+    } else if (!S_ISDIR(inode_entry->i_mode)) {
+        /* NOTE: Only directories matter for the path index */
+        return 0;
+    }
+
+    int flags = EXT2SCAN_WALK_BLOCKS;
+    if (path_index && allocated) {
+        flags |= WALK_INDEX_ENTRIES;
+    }
+
+    /* NOTE: Directory blocks are only scanned if something needs the entries */
+    if (print_records || checker || (flags & WALK_INDEX_ENTRIES)) {
+        flags |= EXT2SCAN_READ_DIRS;
+    }
+    return flags;
+}
+
+/* Print the SUPERBLOCK and GROUP records. With --format=binary they go to
+ * a segment of their own instead, which is returned for scan_groups.
+ */
+static struct segment *print_summary(struct ext2scan *scan, struct fs *fs,
+        struct outbuf *out) {
+    struct segment *summary_columns = NULL;
+    struct summary_ctx summary;
+    summary.out = out;
+    summary.cols = NULL;
+    summary.fs = fs;
+
+    struct ext2scan_visitor visitor;
+    memset(&visitor, 0, sizeof(visitor));
+    visitor.arg = &summary;
+    if (output_format == FORMAT_BINARY) {
+        summary_columns = new_segment(NULL);
+        summary.cols = summary_columns->outs;
+        visitor.superblock = put_superblock_columns;
+        visitor.group = put_group_columns;
+    } else {
+        visitor.superblock = print_superblock_summary;
+        visitor.group = print_group_summary;
+    }
+    ext2scan_summary(scan, &visitor);
+
+    return summary_columns;
+}
+
+/* Store the records of every group in the incremental index. The
+ * segments of a group run from its head segment to the next group's.
+ */
+static void save_index(struct fs *fs, struct segment **heads) {
+    if (incr_save_begin(incremental) == -1) {
+        fprintf(stderr, "Unable to write incremental index!\n");
+        exit(2);
+    }
+
+    for (uint32_t g = 0; g < fs->num_groups; g++) {
+        struct segment *end = g + 1 < fs->num_groups ? heads[g + 1] : NULL;
+        for (int s = 0; s < num_streams; s++) {
+            for (struct segment *seg = heads[g]; seg != end; seg = seg->next) {
+                incr_save_records(incremental, g, s, seg->outs[s].buf, seg->outs[s].len);
             }
         }
     }
+
+    if (incr_save_end(incremental) == -1) {
+        fprintf(stderr, "Unable to write incremental index!\n");
+        exit(2);
+    }
+}
+
+/* Every record ends with a newline */
+static uint64_t count_records(const struct outbuf *ob) {
+    uint64_t n = 0;
+    const char *p = ob->buf;
+    const char *end = ob->buf + ob->len;
+    while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+        n++;
+        p++;
+    }
+    return n;
+}
+
+/* Write the tables of --format=binary. order holds the buffers of each
+ * column in chain order, num_segments per column.
+ */
+static void write_columns(struct outbuf *out, struct outbuf **order, size_t num_segments) {
+    struct colfmt_source sources[NUM_COLUMNS];
+    for (int c = 0; c < NUM_COLUMNS; c++) {
+        const struct column_def *def = &column_defs[c];
+        sources[c].table = def->table;
+        sources[c].name = def->name;
+        sources[c].type = def->type;
+        sources[c].width = def->width;
+        sources[c].count = def->count;
+        sources[c].bufs = order + c * num_segments;
+        sources[c].num_bufs = num_segments;
+
+        /* NOTE: SUPERBLOCK and GROUP are counted by main */
+        if (run_stats && c >= COL_BFREE && strcmp(def->table, column_defs[c - 1].table) != 0) {
+            uint64_t rows = colfmt_rows(&sources[c]);
+            if (rows > 0) {
+                stats_add_records(run_stats, def->table, rows);
+            }
+        }
+    }
+
+    outbuf_flush(out);
+    if (colfmt_write(out->fd, sources, NUM_COLUMNS) == -1) {
+        out->error = 1;
+    }
 }
 
-/* Visit indirect blocks */
-void visit_indirect_refs(int level_current, int block_id,
-            int block_size, int num_entries, int img_fd,
-            int inode_id, int lbo) {
-    char block[block_size];
-    int offset = get_offset(block_id, block_size);
-    pread(img_fd, block, block_size, offset);
+/* Groups are scanned concurrently into their own segments and large files
+ * are split further while they are walked. The segments are then written
+ * out stream by stream in chain order, which keeps the output identical to
+ * a serial run.
+ *
+ * With --format=binary, summary holds the SUPERBLOCK and GROUP columns and
+ * goes first; it is freed along with the other segments.
+ */
+void scan_groups(struct ext2scan *scan, struct fs *fs, struct outbuf *out,
+        struct segment *summary) {
+    struct segment **heads = calloc(fs->num_groups, sizeof(struct segment *));
+    if (heads == NULL) {
+        fprintf(stderr, "Unable to allocate task queue!\n");
+        exit(2);
+    }
+
+    /* NOTE: Build the chain back to front so each head links to the next */
+    struct segment *first = NULL;
+    for (uint32_t g = fs->num_groups; g-- > 0;) {
+        first = new_segment(first);
+        heads[g] = first;
+    }
+    uint32_t num_cached = 0;
+    for (uint32_t g = 0; incremental && g < fs->num_groups; g++) {
+        if (incr_cached(incremental, g)) {
+            /* NOTE: Unchanged groups reuse the records of the last run */
+            for (int s = 0; s < num_streams; s++) {
+                size_t len;
+                const void *records = incr_records(incremental, g, s, &len);
+                outbuf_put_mem(&heads[g]->outs[s], records, len);
+            }
+            num_cached++;
+        }
+    }
+
+    struct ext2scan_visitor visitor;
+    memset(&visitor, 0, sizeof(visitor));
+    visitor.arg = heads;
+    visitor.begin_group = begin_group;
+    visitor.split = split_output;
+    visitor.inode = visit_inode;
+    visitor.dirent = visit_dirent;
+    if (output_format == FORMAT_BINARY) {
+        visitor.free_blocks = put_free_block_columns;
+        visitor.free_inodes = put_free_inode_columns;
+        visitor.indirect = put_indirect_columns;
+    } else if (print_records) {
+        visitor.free_blocks = print_free_blocks;
+        visitor.free_inodes = print_free_inodes;
+        visitor.indirect = print_indirect_ref;
+    }
+    if (checker || block_map || block_hashes) {
+        visitor.block = visit_ref;
+    }
+
+    if (ext2scan_groups(scan, &visitor) == -1) {
+        fprintf(stderr, "Unable to allocate task queue!\n");
+        exit(2);
+    }
 
-    int *ptr = (int *) block;
+    if (summary) {
+        summary->next = first;
+        first = summary;
+    }
 
+    size_t num_segments = 0;
+    for (struct segment *seg = first; seg != NULL; seg = seg->next) {
+        num_segments++;
+    }
 
-    if (level_current == 1) {
-        for (int i = 0; i < num_entries; i++) {
-            if (*ptr) {
-                printf("INDIRECT,%d,%d,%d,%d,%d\n",
-                        inode_id, level_current, lbo + i,
-                        block_id, *ptr);
+    struct outbuf **order = calloc(num_segments * num_streams + 1,
+            sizeof(struct outbuf *));
+    if (order == NULL) {
+        fprintf(stderr, "Unable to allocate output buffer!\n");
+        exit(2);
+    }
+
+    size_t n = 0;
+    for (int s = 0; s < num_streams; s++) {
+        uint64_t records = 0;
+        for (struct segment *seg = first; seg != NULL; seg = seg->next) {
+            order[n++] = &seg->outs[s];
+            if (run_stats && output_format == FORMAT_CSV) {
+                records += count_records(&seg->outs[s]);
             }
-            ptr++;
-        }   
-        return;
+        }
+        if (records > 0) {
+            stats_add_records(run_stats, stream_names[s], records);
+        }
     }
-    
-    for (int i = 0; i < num_entries; i++) {
-        if (*ptr == 0) {
-            continue;
+
+    if (output_format == FORMAT_BINARY) {
+        write_columns(out, order, num_segments);
+    } else {
+        outbuf_flush(out);
+        if (outbuf_writev(out->fd, order, n) == -1) {
+            out->error = 1;
         }
-        printf("INDIRECT,%d,%d,%d,%d,%d\n",
-                inode_id, level_current, lbo,
-                block_id, *ptr);
-        visit_indirect_refs(level_current - 1, *ptr, block_size,
-                num_entries, img_fd, inode_id, lbo);
-        lbo += num_entries;
-        ptr++;
     }
+
+    /* NOTE: An index that served every group is still up to date */
+    if (incremental && num_cached < fs->num_groups) {
+        save_index(fs, heads);
+    }
+    free(heads);
+
+    while (first != NULL) {
+        struct segment *next = first->next;
+        for (int s = 0; s < num_streams; s++) {
+            outbuf_free(&first->outs[s]);
+        }
+        free(first);
+        first = next;
+    }
+    free(order);
 }
 
-/* Print indirect block references:
- * INDIRECT
+/* Print the owners of a block as recorded in a reverse map:
+ * OWNER
+ * block number (decimal)
  * I-node number of the owning file (decimal)
- * (decimal) level of indirection for the block being scanned ... 1 for single indirect, 2 for double indirect, 3 for triple
- * logical block offset (decimal) represented by the referenced block. If the referenced block is a data block, this is the logical block offset of that block within the file. If the referenced block is a single- or double-indirect block, this is the same as the logical offset of the first data block to which it refers.
- * block number of the (1, 2, 3) indirect block being scanned (decimal) . . . not the highest level block (in the recursive scan), but the lower level block that contains the block reference reported by this entry.
- * block number of the referenced block (decimal)
+ * logical block offset (decimal) of the block within the file, or of the first data block it covers for indirect blocks
+ */
+void print_block_owners(struct outbuf *out, const struct revmap_file *file, uint32_t block_id) {
+    size_t count;
+    const struct revmap_entry *e = revmap_find(file, block_id, &count);
+
+    for (size_t i = 0; i < count; i++) {
+        outbuf_put_str(out, "OWNER");
+        put_field(out, e[i].block);
+        put_field(out, e[i].inode);
+        put_field(out, e[i].lbo);
+        outbuf_put_char(out, '\n');
+    }
+}
+
+/* Answer --lookup queries from a reverse map file without the image */
+static void lookup_owners(const char *revmap_path, const uint32_t *blocks, int num_blocks) {
+    struct revmap_file file;
+    if (revmap_open(&file, revmap_path) == -1) {
+        fprintf(stderr, "%s is not a valid reverse map!\n", revmap_path);
+        exit(1);
+    }
+
+    struct outbuf out;
+    if (outbuf_init(&out, STDOUT_FILENO, OUTBUF_DEFAULT_SIZE) == -1) {
+        fprintf(stderr, "Unable to allocate output buffer!\n");
+        exit(2);
+    }
+
+    for (int i = 0; i < num_blocks; i++) {
+        print_block_owners(&out, &file, blocks[i]);
+    }
+
+    if (outbuf_flush(&out) == -1) {
+        fprintf(stderr, "Unable to write output!\n");
+        exit(2);
+    }
+    outbuf_free(&out);
+    revmap_close(&file);
+
+    exit(0);
+}
+
+/* Answer a --where query from the inode columns. Matching inodes are
+ * printed as INODE records in inode order.
+ */
+static void query_inodes(struct fs *fs, struct pool *pool, const struct inodecol_query *query,
+        struct outbuf *out) {
+    stats_begin(run_stats);
+    struct inodecol ic;
+    if (inodecol_load(&ic, fs, pool) == -1) {
+        fprintf(stderr, "Unable to allocate inode columns!\n");
+        exit(2);
+    }
+    stats_end(run_stats, "inode_columns");
+
+    stats_begin(run_stats);
+    uint64_t *matches = inodecol_filter(&ic, query, pool);
+    if (matches == NULL) {
+        fprintf(stderr, "Unable to allocate inode columns!\n");
+        exit(2);
+    }
+    stats_end(run_stats, "where");
+
+    stats_begin(run_stats);
+    uint64_t count = 0;
+    size_t num_words = ((size_t) ic.num_rows + 63) / 64;
+    for (size_t w = 0; w < num_words; w++) {
+        for (uint64_t bits = matches[w]; bits != 0; bits &= bits - 1) {
+            uint32_t inode_id = w * 64 + __builtin_ctzll(bits) + 1;
+            struct ext2_inode inode_entry;
+            if (fs_read_inode(fs, inode_id, &inode_entry) == 0) {
+                print_inode_summary(out, inode_id, &inode_entry);
+                count++;
+            }
+        }
+    }
+    stats_end(run_stats, "print");
+    stats_add_records(run_stats, "INODE", count);
+
+    free(matches);
+    inodecol_free(&ic);
+}
+
+/* State of --serve, kept for the lifetime of the daemon. The reverse map
+ * for OWNER requests is built by the first of them.
  */
-void print_indirect_block_refs(int img_fd, struct ext2_super_block *sb,
-        struct ext2_group_desc *grp) {
-    int inodes_in_group;
-    int inode_table;
-    struct ext2_inode table[sb->s_inodes_per_group];
-    int block_size = EXT2_MIN_BLOCK_SIZE << sb->s_log_block_size;
+struct server {
+    struct fs *fs;
+    struct pool *pool;
+    struct ext2scan *scan;
+    int have_owners;
+    struct revmap_file owners;
+};
+
+/* Destination of a LIST request */
+struct list_ctx {
+    struct outbuf *out;
+    int is_dir;
+};
+
+static int list_inode(struct ext2scan_ctx *ctx, uint32_t inode_id,
+        const struct ext2_inode *inode_entry) {
+    struct list_ctx *list = ctx->arg;
+    (void) inode_id;
+    if (!inode_entry->i_mode || !inode_entry->i_links_count ||
+            !S_ISDIR(inode_entry->i_mode)) {
+        return 0;
+    }
+    list->is_dir = 1;
+    return EXT2SCAN_WALK_BLOCKS | EXT2SCAN_READ_DIRS;
+}
 
-    /* Number of 32-bit block pointers in a block */
-    /* NOTE: block size is in bytes */
-    int num_entries = (block_size * 8) / 32;
+static void list_dirent(struct ext2scan_ctx *ctx, uint64_t offset,
+        const struct ext2_dir_entry *dirent, int name_len) {
+    struct list_ctx *list = ctx->arg;
+    print_dirent(list->out, ctx->inode_id, offset, dirent, name_len);
+}
 
-    inode_table = grp->bg_inode_table;
-    inodes_in_group = sb->s_inodes_per_group;
+/* NOTE: --serve sets --ranges, so free runs are printed as ranges */
+static void serve_free_blocks(struct ext2scan_ctx *ctx, uint32_t first, uint32_t count) {
+    print_free_run(ctx->arg, "BFREE", first, count);
+}
 
-    int table_offset = get_offset(inode_table, block_size);
-    pread(img_fd, table, sizeof(table), table_offset);
+static void serve_free_inodes(struct ext2scan_ctx *ctx, uint32_t first, uint32_t count) {
+    print_free_run(ctx->arg, "IFREE", first, count);
+}
 
-    for (int j = 0; j < inodes_in_group; j++) {
-        int inode_id = j + 1;
-        struct ext2_inode *inode_entry = &table[j];
-        int lbo = 12;
-        if (S_ISDIR(inode_entry->i_mode) || S_ISREG(inode_entry->i_mode)) {
-            /* Scan indirect blocks */ 
-            visit_indirect_refs(1, inode_entry->i_block[12], block_size,
-                    num_entries, img_fd, inode_id, lbo);
-            lbo += num_entries;
+/* Parse a decimal request argument.
+ *
+ * Return 0 on success, -1 on error
+ */
+static int parse_id(const char *arg, uint32_t *id) {
+    char *end;
+    if (*arg < '0' || *arg > '9') {
+        return -1;
+    }
+    unsigned long v = strtoul(arg, &end, 10);
+    if (*end != '\0' || v > UINT32_MAX) {
+        return -1;
+    }
+    *id = v;
+    return 0;
+}
 
-            /* Scan double indirect blocks */
-            visit_indirect_refs(2, inode_entry->i_block[13], block_size,
-                    num_entries, img_fd, inode_id, lbo);
-            lbo += num_entries * num_entries;
+/* Answer a --serve request:
+ *
+ *     INODE inode          INODE record of an allocated inode
+ *     LIST path|inode      DIRENT records of a directory
+ *     OWNER block          OWNER records of a block
+ *     BFREE [group]        BFREE_RANGE records of a group, or of all groups
+ *     IFREE [group]        IFREE_RANGE records of a group, or of all groups
+ */
+static uint32_t answer_request(void *arg, char *request, struct outbuf *reply) {
+    struct server *srv = arg;
+    struct fs *fs = srv->fs;
+
+    char *verb = request;
+    char *operand = strchr(request, ' ');
+    if (operand) {
+        *operand++ = '\0';
+    }
 
-            /* Scan triple indirect blocks */
-            visit_indirect_refs(3, inode_entry->i_block[14], block_size,
-                    num_entries, img_fd, inode_id, lbo);
-            lbo += num_entries * num_entries * num_entries;
+    uint32_t id = 0;
+    if (strcmp(verb, "INODE") == 0) {
+        struct ext2_inode inode_entry;
+        if (operand == NULL || parse_id(operand, &id) == -1) {
+            return SERVE_BAD_REQUEST;
+        }
+        if (fs_read_inode(fs, id, &inode_entry) == -1 || !inode_entry.i_mode ||
+                !inode_entry.i_links_count) {
+            return SERVE_NOT_FOUND;
         }
+        print_inode_summary(reply, id, &inode_entry);
+        return SERVE_OK;
     }
+
+    if (strcmp(verb, "LIST") == 0) {
+        if (operand == NULL) {
+            return SERVE_BAD_REQUEST;
+        }
+        if (*operand == '/') {
+            id = htree_resolve(fs, operand);
+        } else if (parse_id(operand, &id) == -1) {
+            return SERVE_BAD_REQUEST;
+        }
+
+        struct list_ctx list;
+        list.out = reply;
+        list.is_dir = 0;
+        struct ext2scan_visitor visitor;
+        memset(&visitor, 0, sizeof(visitor));
+        visitor.arg = &list;
+        visitor.inode = list_inode;
+        visitor.dirent = list_dirent;
+        if (ext2scan_inode(srv->scan, id, &visitor) == -1 || !list.is_dir) {
+            return SERVE_NOT_FOUND;
+        }
+        return SERVE_OK;
+    }
+
+    if (strcmp(verb, "OWNER") == 0) {
+        if (operand == NULL || parse_id(operand, &id) == -1) {
+            return SERVE_BAD_REQUEST;
+        }
+        if (!srv->have_owners) {
+            /* NOTE: Blocks of files are only known after a full walk */
+            block_map = revmap_create(fs, pool_size(srv->pool));
+            if (block_map == NULL) {
+                return SERVE_ERROR;
+            }
+            scan_groups(srv->scan, fs, reply, NULL);
+            int rc = revmap_build(block_map, &srv->owners);
+            revmap_destroy(block_map);
+            block_map = NULL;
+            if (rc == -1) {
+                return SERVE_ERROR;
+            }
+            srv->have_owners = 1;
+        }
+        print_block_owners(reply, &srv->owners, id);
+        return SERVE_OK;
+    }
+
+    int bfree = strcmp(verb, "BFREE") == 0;
+    if (bfree || strcmp(verb, "IFREE") == 0) {
+        struct ext2scan_visitor visitor;
+        memset(&visitor, 0, sizeof(visitor));
+        visitor.arg = reply;
+        if (bfree) {
+            visitor.free_blocks = serve_free_blocks;
+        } else {
+            visitor.free_inodes = serve_free_inodes;
+        }
+
+        if (operand == NULL) {
+            for (uint32_t g = 0; g < fs->num_groups; g++) {
+                ext2scan_free_runs(srv->scan, g, &visitor);
+            }
+            return SERVE_OK;
+        }
+        if (parse_id(operand, &id) == -1) {
+            return SERVE_BAD_REQUEST;
+        }
+        if (id >= fs->num_groups) {
+            return SERVE_NOT_FOUND;
+        }
+        ext2scan_free_runs(srv->scan, id, &visitor);
+        return SERVE_OK;
+    }
+
+    return SERVE_BAD_REQUEST;
 }
 
+/* Send --query requests to a daemon and print the records of the replies */
+static void send_queries(const char *socket_path, char **requests, int num_requests) {
+    uint32_t *statuses = calloc(num_requests, sizeof(uint32_t));
+    if (statuses == NULL) {
+        fprintf(stderr, "Unable to allocate query buffer!\n");
+        exit(2);
+    }
 
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Invalid invocation!\nUsage: ./lab3a [image]\n");
+    if (serve_query(socket_path, requests, num_requests, statuses, STDOUT_FILENO) == -1) {
+        fprintf(stderr, "Unable to query %s!\n", socket_path);
         exit(1);
     }
 
-    char *img_name = argv[1];
-    int img_fd = open(img_name, O_RDONLY);
-    if (img_fd == -1) {
+    static const char *errors[] = {
+        [SERVE_NOT_FOUND] = "was not found",
+        [SERVE_BAD_REQUEST] = "is not a valid request",
+        [SERVE_ERROR] = "failed"
+    };
+    int exit_code = 0;
+    for (int i = 0; i < num_requests; i++) {
+        if (statuses[i] != SERVE_OK) {
+            const char *error = statuses[i] <= SERVE_ERROR ? errors[statuses[i]] : "failed";
+            fprintf(stderr, "%s %s!\n", requests[i], error);
+            exit_code = 1;
+        }
+    }
+    free(statuses);
+
+    exit(exit_code);
+}
+
+/* State of --batch shared by the workers */
+struct batch {
+    char **images;
+    char **outputs;             /* Output file of every image */
+    int *exit_codes;            /* Exit code of every image */
+    struct batch_limits *limits;
+    int image_flags;
+    long cache_blocks;
+    int prefetch_depth;
+};
+
+/* Rough upper bound on the memory taken by analyzing an image: its records,
+ * which are held until the scan has finished, the output buffer and the
+ * block cache of the pread fallback
+ */
+static uint64_t estimate_memory(struct fs *fs, long cache_blocks) {
+    const struct ext2_super_block *sb = &fs->sb;
+    uint64_t used_inodes = sb->s_inodes_count - sb->s_free_inodes_count;
+    uint64_t used_blocks = sb->s_blocks_count - sb->s_free_blocks_count;
+
+    /* NOTE: At most an INODE and a DIRENT record per inode and an INDIRECT
+     * record per block
+     */
+    uint64_t bytes = OUTBUF_DEFAULT_SIZE + used_inodes * 256 + used_blocks * 48;
+    if (!output_ranges) {
+        bytes += ((uint64_t) sb->s_free_inodes_count + sb->s_free_blocks_count) * 20;
+    }
+    if (fs->img->map == NULL) {
+        bytes += (uint64_t) cache_blocks * fs->block_size;
+    }
+    return bytes;
+}
+
+/* Analyze one image of --batch and write its records to its own file.
+ *
+ * NOTE: Images are the unit of parallelism here, so each one is scanned on
+ * the worker that picked it up, through a pool of its own without threads
+ */
+static void batch_image(void *arg, size_t i) {
+    struct batch *batch = arg;
+    const char *img_name = batch->images[i];
+
+    struct image image;
+    if (image_open(&image, img_name, batch->image_flags) == -1) {
         fprintf(stderr, "%s is a nonexistent file!\n", img_name);
-        exit(1);
+        batch->exit_codes[i] = 1;
+        return;
+    }
+
+    struct fs fs;
+    if (fs_open(&fs, &image) == -1) {
+        fprintf(stderr, "%s is a corrupted file system!\n", img_name);
+        batch->exit_codes[i] = 2;
+        image_close(&image);
+        return;
+    }
+
+    int fd = open(batch->outputs[i], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        fprintf(stderr, "Unable to write %s!\n", batch->outputs[i]);
+        batch->exit_codes[i] = 2;
+        fs_close(&fs);
+        image_close(&image);
+        return;
+    }
+
+    uint64_t reserved = estimate_memory(&fs, batch->cache_blocks);
+    batch_reserve(batch->limits, reserved);
+    batch_begin_io(batch->limits);
+
+    if (image_set_cache(&image, batch->cache_blocks) == -1) {
+        fprintf(stderr, "Unable to allocate block cache!\n");
+        exit(2);
+    }
+
+    struct outbuf out;
+    if (outbuf_init(&out, fd, OUTBUF_DEFAULT_SIZE) == -1) {
+        fprintf(stderr, "Unable to allocate output buffer!\n");
+        exit(2);
+    }
+
+    struct pool *pool = pool_create(1);
+    if (pool == NULL) {
+        fprintf(stderr, "Unable to create thread pool!\n");
+        exit(2);
+    }
+
+    struct ext2scan *scan = ext2scan_create(&fs, pool);
+    if (scan == NULL) {
+        fprintf(stderr, "Unable to allocate scanner!\n");
+        exit(2);
+    }
+    if (batch->prefetch_depth > 0) {
+        if (ext2scan_set_prefetch(scan, batch->prefetch_depth) == -1) {
+            fprintf(stderr, "Unable to allocate prefetch buffers!\n");
+            exit(2);
+        }
+    }
+
+    struct segment *summary_columns = print_summary(scan, &fs, &out);
+    image_advise(&image, 0, 0, IMAGE_ADV_RANDOM);
+    scan_groups(scan, &fs, &out, summary_columns);
+    ext2scan_destroy(scan);
+    pool_destroy(pool);
+
+    if (outbuf_flush(&out) == -1 || close(fd) == -1) {
+        fprintf(stderr, "Unable to write %s!\n", batch->outputs[i]);
+        batch->exit_codes[i] = 2;
+    }
+    outbuf_free(&out);
+    fs_close(&fs);
+    image_close(&image);
+
+    batch_end_io(batch->limits);
+    batch_release(batch->limits, reserved);
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/* Analyze every image of --batch concurrently on the threads of pool. The
+ * records of an image go to a file named after it in output_dir.
+ *
+ * Return the highest exit code of the images
+ */
+static int run_batch(const char *output_dir, char **images, size_t num_images,
+        struct pool *pool, struct batch_limits *limits, int image_flags, long cache_blocks,
+        int prefetch_depth) {
+    struct batch batch;
+    batch.images = images;
+    batch.outputs = calloc(num_images, sizeof(char *));
+    batch.exit_codes = calloc(num_images, sizeof(int));
+    batch.limits = limits;
+    batch.image_flags = image_flags;
+    batch.cache_blocks = cache_blocks;
+    batch.prefetch_depth = prefetch_depth;
+    char **sorted = malloc(num_images * sizeof(char *));
+    if (batch.outputs == NULL || batch.exit_codes == NULL || sorted == NULL) {
+        fprintf(stderr, "Unable to allocate batch state!\n");
+        exit(2);
+    }
+
+    const char *suffix = output_format == FORMAT_BINARY ? ".bin" : ".csv";
+    for (size_t i = 0; i < num_images; i++) {
+        const char *slash = strrchr(images[i], '/');
+        const char *name = slash ? slash + 1 : images[i];
+        size_t len = strlen(output_dir) + strlen(name) + strlen(suffix) + 2;
+        batch.outputs[i] = malloc(len);
+        if (batch.outputs[i] == NULL) {
+            fprintf(stderr, "Unable to allocate batch state!\n");
+            exit(2);
+        }
+        snprintf(batch.outputs[i], len, "%s/%s%s", output_dir, name, suffix);
+        sorted[i] = batch.outputs[i];
+    }
+
+    /* NOTE: Images with the same file name would overwrite each other */
+    qsort(sorted, num_images, sizeof(char *), compare_names);
+    for (size_t i = 1; i < num_images; i++) {
+        if (strcmp(sorted[i - 1], sorted[i]) == 0) {
+            fprintf(stderr, "%s is the output of more than one image!\n", sorted[i]);
+            exit(1);
+        }
+    }
+    free(sorted);
+
+    pool_for(pool, num_images, batch_image, &batch);
+
+    int exit_code = 0;
+    for (size_t i = 0; i < num_images; i++) {
+        if (batch.exit_codes[i] > exit_code) {
+            exit_code = batch.exit_codes[i];
+        }
+        free(batch.outputs[i]);
+    }
+    free(batch.outputs);
+    free(batch.exit_codes);
+
+    return exit_code;
+}
+
+static void usage(void) {
+    fprintf(stderr, "Invalid invocation!\nUsage: ./lab3a [--no-mmap] [--threads=N] "
+            "[--cache-blocks=N] [--prefetch[=DEPTH]] [--stats[=FILE]] [--format=csv|binary] "
+            "[--ranges] "
+            "[--incremental=FILE] [--check] [--paths] [--resolve=PATH] [--revmap=FILE] "
+            "[--where=QUERY] [--hash-blocks] [--serve=SOCKET] "
+            "[image]\n"
+            "       ./lab3a --revmap=FILE --lookup=BLOCK...\n"
+            "       ./lab3a --query=SOCKET REQUEST...\n"
+            "       ./lab3a --batch=DIR [--io-limit=N] [--memory-budget=MB] [--no-mmap] "
+            "[--threads=N] [--cache-blocks=N] [--prefetch[=DEPTH]] [--format=csv|binary] "
+            "[--ranges] [image...]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"no-mmap", no_argument, 0, 'm'},
+        {"threads", required_argument, 0, 'j'},
+        {"cache-blocks", required_argument, 0, 'c'},
+        {"prefetch", optional_argument, 0, 'P'},
+        {"stats", optional_argument, 0, 'S'},
+        {"incremental", required_argument, 0, 'I'},
+        {"format", required_argument, 0, 'F'},
+        {"ranges", no_argument, 0, 'r'},
+        {"check", no_argument, 0, 'k'},
+        {"paths", no_argument, 0, 'p'},
+        {"resolve", required_argument, 0, 'R'},
+        {"revmap", required_argument, 0, 'M'},
+        {"lookup", required_argument, 0, 'L'},
+        {"where", required_argument, 0, 'W'},
+        {"hash-blocks", no_argument, 0, 'H'},
+        {"serve", required_argument, 0, 'D'},
+        {"query", required_argument, 0, 'Q'},
+        {"batch", required_argument, 0, 'B'},
+        {"io-limit", required_argument, 0, 'O'},
+        {"memory-budget", required_argument, 0, 'G'},
+        {0, 0, 0, 0}
+    };
+
+    int image_flags = 0;
+    int num_threads = pool_default_threads();
+    long cache_blocks = CACHE_DEFAULT_BLOCKS;
+    int prefetch_depth = 0;
+    int stats_mode = 0;
+    const char *stats_path = NULL;     /* NULL for stderr */
+    const char *incr_path = NULL;
+    int check_mode = 0;
+    int print_paths = 0;
+    const char *resolve_path = NULL;
+    const char *revmap_path = NULL;
+    struct inodecol_query query;
+    int where_mode = 0;
+    int hash_mode = 0;
+    const char *serve_path = NULL;
+    const char *query_path = NULL;
+    const char *batch_dir = NULL;
+    int io_limit = 0;               /* 0 for one image per thread */
+    uint64_t memory_budget = 0;     /* 0 for no budget */
+    uint32_t *lookups = malloc(argc * sizeof(uint32_t));
+    int num_lookups = 0;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "j:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'm':
+                image_flags |= IMAGE_NO_MMAP;
+                break;
+            case 'j':
+                num_threads = atoi(optarg);
+                if (num_threads < 1) {
+                    usage();
+                }
+                break;
+            case 'F':
+                if (strcmp(optarg, "csv") == 0) {
+                    output_format = FORMAT_CSV;
+                } else if (strcmp(optarg, "binary") == 0) {
+                    output_format = FORMAT_BINARY;
+                } else {
+                    usage();
+                }
+                break;
+            case 'r':
+                output_ranges = 1;
+                break;
+            case 'k':
+                check_mode = 1;
+                break;
+            case 'p':
+                print_paths = 1;
+                break;
+            case 'R':
+                resolve_path = optarg;
+                break;
+            case 'M':
+                revmap_path = optarg;
+                break;
+            case 'W':
+                if (inodecol_parse(&query, optarg) == -1) {
+                    fprintf(stderr, "%s is not a valid query!\n", optarg);
+                    exit(1);
+                }
+                where_mode = 1;
+                break;
+            case 'H':
+                hash_mode = 1;
+                break;
+            case 'D':
+                serve_path = optarg;
+                break;
+            case 'Q':
+                query_path = optarg;
+                break;
+            case 'B':
+                batch_dir = optarg;
+                break;
+            case 'O':
+                io_limit = atoi(optarg);
+                if (io_limit < 1) {
+                    usage();
+                }
+                break;
+            case 'G': {
+                char *end;
+                unsigned long long mb = strtoull(optarg, &end, 10);
+                if (*optarg < '0' || *optarg > '9' || *end != '\0' || mb == 0 ||
+                        mb > UINT64_MAX >> 20) {
+                    usage();
+                }
+                memory_budget = mb << 20;
+                break;
+            }
+            case 'L': {
+                char *end;
+                unsigned long block_id = strtoul(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || block_id > UINT32_MAX) {
+                    usage();
+                }
+                lookups[num_lookups++] = block_id;
+                break;
+            }
+            case 'c':
+                cache_blocks = atol(optarg);
+                if (cache_blocks < 0) {
+                    usage();
+                }
+                break;
+            case 'I':
+                incr_path = optarg;
+                break;
+            case 'S':
+                stats_mode = 1;
+                stats_path = optarg;
+                break;
+            case 'P':
+                prefetch_depth = optarg ? atoi(optarg) : PREFETCH_DEFAULT_DEPTH;
+                if (prefetch_depth < 1 || prefetch_depth > PREFETCH_MAX_DEPTH) {
+                    usage();
+                }
+                break;
+            default:
+                usage();
+        }
     }
 
-    struct ext2_super_block sb;
-    pread(img_fd, &sb, sizeof(struct ext2_super_block), SUPER_BLOCK_OFFSET);
+    if (num_lookups > 0) {
+        if (revmap_path == NULL || optind != argc) {
+            usage();
+        }
+        lookup_owners(revmap_path, lookups, num_lookups);
+    }
+    free(lookups);
 
-    int block_size = EXT2_MIN_BLOCK_SIZE  << sb.s_log_block_size;
+    if (query_path) {
+        if (optind == argc) {
+            usage();
+        }
+        send_queries(query_path, argv + optind, argc - optind);
+    }
 
-    struct ext2_group_desc grp;
-    int grp_desc_table_offset = get_offset(2, block_size);
-    pread(img_fd, &grp, sizeof(grp), grp_desc_table_offset);
+    /* NOTE: Only the records are kept per image; the other modes, --stats
+     * and --incremental hold state for a single one
+     */
+    if ((io_limit || memory_budget) && batch_dir == NULL) {
+        usage();
+    }
+    if (batch_dir) {
+        if (check_mode || print_paths || resolve_path || revmap_path || where_mode ||
+                hash_mode || serve_path || incr_path || stats_mode) {
+            usage();
+        }
 
-    int rc = print_superblock_summary(&sb);
-    if (rc == -1) {
+        char **images = argv + optind;
+        size_t num_images = argc - optind;
+        char **manifest = NULL;
+        if (num_images == 0) {
+            manifest = batch_read_manifest(stdin, &num_images);
+            if (manifest == NULL) {
+                fprintf(stderr, "Unable to read image list!\n");
+                exit(2);
+            }
+            images = manifest;
+        }
+        if (num_images == 0) {
+            usage();
+        }
+        if (output_format == FORMAT_BINARY) {
+            num_streams = NUM_COLUMNS;
+        }
+
+        struct pool *pool = pool_create(num_threads);
+        if (pool == NULL) {
+            fprintf(stderr, "Unable to create thread pool!\n");
+            exit(2);
+        }
+        struct batch_limits *limits = batch_limits_create(
+                io_limit ? io_limit : pool_size(pool), memory_budget);
+        if (limits == NULL) {
+            fprintf(stderr, "Unable to allocate batch state!\n");
+            exit(2);
+        }
+        int exit_code = run_batch(batch_dir, images, num_images, pool, limits, image_flags,
+                cache_blocks, prefetch_depth);
+
+        batch_limits_destroy(limits);
+        pool_destroy(pool);
+        if (manifest) {
+            batch_free_manifest(manifest, num_images);
+        }
+        exit(exit_code);
+    }
+
+    /* NOTE: --check, --resolve, --revmap, --where, --hash-blocks and --serve
+     * replace the records
+     */
+    if (optind != argc - 1 || check_mode + (resolve_path != NULL) + (revmap_path != NULL) +
+            where_mode + hash_mode + (serve_path != NULL) > 1) {
+        usage();
+    }
+    if ((where_mode || hash_mode || serve_path) &&
+            (print_paths || incr_path || output_format == FORMAT_BINARY)) {
+        usage();
+    }
+
+    /* NOTE: Cached groups are never walked, so only plain records work */
+    if (incr_path && (check_mode || print_paths || resolve_path || revmap_path)) {
+        usage();
+    }
+
+    /* NOTE: Only the records have a binary form */
+    if (output_format == FORMAT_BINARY &&
+            (check_mode || print_paths || resolve_path || revmap_path)) {
+        usage();
+    }
+    if (output_format == FORMAT_BINARY) {
+        num_streams = NUM_COLUMNS;
+    }
+
+    struct stats stats;
+    if (stats_mode) {
+        run_stats = &stats;
+        stats_init(run_stats, num_threads);
+    }
+
+    /* Superblock, group descriptors and block cache */
+    stats_begin(run_stats);
+    char *img_name = argv[optind];
+    struct image image;
+    struct image *img = &image;
+    if (image_open(img, img_name, image_flags) == -1) {
+        fprintf(stderr, "%s is a nonexistent file!\n", img_name);
+        exit(1);
+    }
+    stats_attach(run_stats, img);
+
+    struct fs fs;
+    if (fs_open(&fs, img) == -1) {
         fprintf(stderr, "Corrupted file system!\n");
         exit(2);
     }
-    
-    print_group_summary(&sb, &grp);
 
-    print_free_block_entries(img_fd, &sb, &grp);
+    if (image_set_cache(img, cache_blocks) == -1) {
+        fprintf(stderr, "Unable to allocate block cache!\n");
+        exit(2);
+    }
+    stats_end(run_stats, "open");
+
+    /* Buffers, threads and the state of the selected mode */
+    stats_begin(run_stats);
 
-    print_free_inode_entries(img_fd, &sb, &grp);
+    struct outbuf out;
+    if (outbuf_init(&out, STDOUT_FILENO, OUTBUF_DEFAULT_SIZE) == -1) {
+        fprintf(stderr, "Unable to allocate output buffer!\n");
+        exit(2);
+    }
 
-    print_inode_summary(img_fd, &sb, &grp);
+    struct pool *pool = pool_create(num_threads);
+    if (pool == NULL) {
+        fprintf(stderr, "Unable to create thread pool!\n");
+        exit(2);
+    }
+
+    struct ext2scan *scan = ext2scan_create(&fs, pool);
+    if (scan == NULL) {
+        fprintf(stderr, "Unable to allocate scanner!\n");
+        exit(2);
+    }
 
-    print_dir_entries(img_fd, &sb, &grp);
+    if (prefetch_depth > 0) {
+        if (ext2scan_set_prefetch(scan, prefetch_depth) == -1) {
+            fprintf(stderr, "Unable to allocate prefetch buffers!\n");
+            exit(2);
+        }
+    }
 
-    print_indirect_block_refs(img_fd, &sb, &grp);
+    if (print_paths) {
+        path_index = pathidx_create(&fs, pool_size(pool));
+        if (path_index == NULL) {
+            fprintf(stderr, "Unable to allocate path index!\n");
+            exit(2);
+        }
+    }
 
-    exit(0);
+    if (check_mode) {
+        print_records = 0;
+        checker = check_create(&fs, pool_size(pool));
+        if (checker == NULL) {
+            fprintf(stderr, "Unable to allocate checker state!\n");
+            exit(2);
+        }
+    } else if (resolve_path || where_mode) {
+        print_records = 0;
+    } else if (serve_path) {
+        print_records = 0;
+        output_ranges = 1;
+    } else if (revmap_path) {
+        print_records = 0;
+        block_map = revmap_create(&fs, pool_size(pool));
+        if (block_map == NULL) {
+            fprintf(stderr, "Unable to allocate reverse map!\n");
+            exit(2);
+        }
+    } else if (hash_mode) {
+        print_records = 0;
+        block_hashes = blkhash_create(&fs, pool_size(pool));
+        if (block_hashes == NULL) {
+            fprintf(stderr, "Unable to allocate block hashes!\n");
+            exit(2);
+        }
+    }
+    if (incr_path) {
+        incremental = incr_open(incr_path, &fs, output_ranges | output_format << 1,
+                num_streams);
+        if (incremental == NULL) {
+            fprintf(stderr, "Unable to allocate incremental index!\n");
+            exit(2);
+        }
+    }
+    stats_end(run_stats, "setup");
+
+    struct segment *summary_columns = NULL;
+    if (print_records) {
+        stats_begin(run_stats);
+        summary_columns = print_summary(scan, &fs, &out);
+        stats_end(run_stats, "summary");
+        stats_add_records(run_stats, "SUPERBLOCK", 1);
+        stats_add_records(run_stats, "GROUP", fs.num_groups);
+    }
+
+    /* Directory and indirect blocks are scattered over the image. Inode
+     * tables are read ahead window by window by the inode iterator.
+     *
+     * NOTE: Hinting every group up front costs more than it saves on large
+     * images; each range hint splits the mapping and WILLNEED is serviced
+     * synchronously.
+     */
+    image_advise(img, 0, 0, IMAGE_ADV_RANDOM);
+
+    int exit_code = 0;
+    if (checker) {
+        stats_begin(run_stats);
+        check_scan_inodes(checker, pool);
+        stats_end(run_stats, "check_inodes");
+    }
+
+    if (incremental) {
+        stats_begin(run_stats);
+        incr_fingerprint(incremental, pool);
+        stats_end(run_stats, "fingerprint");
+    }
+
+    if (serve_path) {
+        /* NOTE: The image, block cache and scanner stay open between
+         * requests
+         */
+        stats_begin(run_stats);
+        struct server srv;
+        memset(&srv, 0, sizeof(srv));
+        srv.fs = &fs;
+        srv.pool = pool;
+        srv.scan = scan;
+        if (serve_run(serve_path, answer_request, &srv) == -1) {
+            fprintf(stderr, "Unable to serve on %s!\n", serve_path);
+            exit(2);
+        }
+        if (srv.have_owners) {
+            revmap_close(&srv.owners);
+        }
+        stats_end(run_stats, "serve");
+    } else if (where_mode) {
+        query_inodes(&fs, pool, &query, &out);
+    } else if (print_records || checker || block_map || block_hashes || path_index) {
+        /* Bitmaps, inodes, directory entries and indirect blocks */
+        stats_begin(run_stats);
+        scan_groups(scan, &fs, &out, summary_columns);
+        incr_close(incremental);
+        incremental = NULL;
+        stats_end(run_stats, "scan");
+    }
+    ext2scan_destroy(scan);
+
+    if (checker) {
+        /* NOTE: Like lab3b, exit with 2 if any inconsistency was found */
+        stats_begin(run_stats);
+        int rc = check_finish(checker, pool, &out);
+        if (rc == -1) {
+            fprintf(stderr, "Unable to allocate output buffer!\n");
+            exit(2);
+        }
+        if (rc == 1) {
+            exit_code = 2;
+        }
+        check_destroy(checker);
+        checker = NULL;
+        stats_end(run_stats, "check_finish");
+    }
+
+    if (block_map) {
+        stats_begin(run_stats);
+        if (revmap_write(block_map, revmap_path) == -1) {
+            fprintf(stderr, "Unable to write reverse map %s!\n", revmap_path);
+            exit(2);
+        }
+        revmap_destroy(block_map);
+        block_map = NULL;
+        stats_end(run_stats, "revmap_write");
+    }
+
+    if (block_hashes) {
+        stats_begin(run_stats);
+        if (blkhash_report(block_hashes, pool, &out) == -1) {
+            fprintf(stderr, "Unable to allocate block hashes!\n");
+            exit(2);
+        }
+        blkhash_destroy(block_hashes);
+        block_hashes = NULL;
+        stats_end(run_stats, "hash_report");
+    }
+
+    if (path_index) {
+        stats_begin(run_stats);
+        if (pathidx_build(path_index) == -1) {
+            fprintf(stderr, "Unable to allocate path index!\n");
+            exit(2);
+        }
+        stats_end(run_stats, "path_index");
+
+        stats_begin(run_stats);
+        pathidx_print(path_index, pool, &out);
+        pathidx_destroy(path_index);
+        path_index = NULL;
+        stats_end(run_stats, "paths");
+    }
+
+    /* Print the path as a single PATH record. Only the directories along
+     * the path are read, through their hash index when they have one.
+     */
+    if (resolve_path) {
+        stats_begin(run_stats);
+        uint32_t inode_id = htree_resolve(&fs, resolve_path);
+        if (inode_id == 0) {
+            fprintf(stderr, "%s is a nonexistent path!\n", resolve_path);
+            exit(1);
+        }
+        outbuf_put_str(&out, "PATH");
+        put_field(&out, inode_id);
+        outbuf_put_str(&out, ",'");
+        outbuf_put_str(&out, resolve_path);
+        outbuf_put_str(&out, "'\n");
+        stats_end(run_stats, "resolve");
+    }
+
+    stats_begin(run_stats);
+    if (outbuf_flush(&out) == -1) {
+        fprintf(stderr, "Unable to write output!\n");
+        exit(2);
+    }
+    outbuf_free(&out);
+    stats_end(run_stats, "flush");
+
+    if (stats_write(run_stats, stats_path) == -1) {
+        fprintf(stderr, "Unable to write stats %s!\n", stats_path);
+        exit(2);
+    }
+
+    pool_destroy(pool);
+    fs_close(&fs);
+    image_close(img);
+
+    exit(exit_code);
 }
@@ -0,0 +1,709 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+/* Synthetic ext2 image generator for benchmarking lab3a.
+ *
+ * Builds a revision 1 ext2 image with sparse_super and large_file from a
+ * handful of shape parameters:
+ *
+ *   /lost+found
+ *   /dNNNNNN/fNNNNNNNN     -n files spread over -d directories
+ *   /huge/eNNNNNNNN        -H empty files in a single directory
+ *   /deep/tNNNNNN          -T sparse files reaching into triple indirect
+ *
+ * Only metadata, directory and indirect blocks are written. File data and
+ * unused inode table space are left as holes, so very large images cost
+ * little disk space. The same parameters and seed always give the same
+ * image byte for byte.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include "ext2_fs.h"
+
+#define INODE_SIZE 128
+#define IMAGE_TIME 1500000000
+
+struct params {
+    int block_size;
+    uint32_t groups;
+    uint32_t inodes_per_group;
+    uint32_t dirs;
+    uint32_t files;
+    uint32_t file_blocks;   /* Largest regular file, in blocks */
+    uint32_t huge;
+    uint32_t deep;
+    int frag;               /* Percentage of free blocks skipped */
+    uint64_t seed;
+};
+
+struct gen {
+    int fd;
+    int bs;
+    uint32_t ptrs;          /* Block pointers per indirect block */
+    uint32_t first_data_block;
+    uint32_t bpg;
+    uint32_t ipg;
+    uint32_t groups;
+    uint32_t blocks_count;
+    uint32_t inodes_count;
+    uint32_t gdt_blocks;
+    uint32_t itable_blocks;
+    int frag;
+    uint64_t rng;
+
+    unsigned char *block_bitmap;    /* Bit i is block first_data_block + i */
+    unsigned char *inode_bitmap;    /* Bit i is inode i + 1 */
+    struct ext2_group_desc *gdt;
+
+    uint32_t next_block;
+    uint32_t next_inode;
+};
+
+/* Indirect block being filled in memory */
+struct node {
+    uint32_t block;
+    uint32_t *ptrs;
+    struct node **kids;     /* NULL for single indirect blocks */
+};
+
+/* Block map of a file or directory under construction */
+struct filemap {
+    uint32_t i_block[EXT2_N_BLOCKS];
+    struct node *ind[3];
+    uint32_t num_blocks;    /* Data and indirect blocks */
+};
+
+/* Directory under construction. Only its last block is kept in memory. */
+struct dir {
+    uint32_t inode_id;
+    struct filemap map;
+    char *block;
+    uint32_t block_id;
+    uint64_t lbo;           /* Logical block number of the block in memory */
+    int used;
+    int last;               /* Offset of the last entry in the block */
+    uint16_t links;
+};
+
+static void die(const char *msg) {
+    fprintf(stderr, "%s\n", msg);
+    exit(2);
+}
+
+static void *xcalloc(size_t n, size_t size) {
+    void *p = calloc(n, size);
+    if (p == NULL) {
+        die("Unable to allocate memory!");
+    }
+    return p;
+}
+
+static void write_at(struct gen *gen, const void *buf, size_t len, off_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pwrite(gen->fd, (const char *) buf + done, len - done, offset + done);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            die("Unable to write image!");
+        }
+        done += n;
+    }
+}
+
+static void write_block(struct gen *gen, uint32_t block_id, const void *buf) {
+    write_at(gen, buf, gen->bs, (off_t) block_id * gen->bs);
+}
+
+/* xorshift64*, so images are identical on every platform */
+static uint32_t rng_next(struct gen *gen) {
+    gen->rng ^= gen->rng >> 12;
+    gen->rng ^= gen->rng << 25;
+    gen->rng ^= gen->rng >> 27;
+    return (gen->rng * 0x2545F4914F6CDD1DULL) >> 32;
+}
+
+static int test_bit(const unsigned char *map, uint64_t i) {
+    return map[i / 8] & (1 << (i % 8));
+}
+
+static void set_bit(unsigned char *map, uint64_t i) {
+    map[i / 8] |= 1 << (i % 8);
+}
+
+/* Groups 0, 1 and powers of 3, 5 and 7 keep a superblock backup */
+static int has_super(uint32_t group) {
+    if (group <= 1) {
+        return 1;
+    }
+    for (uint32_t base = 3; base <= 7; base += 2) {
+        uint64_t n = base;
+        while (n < group) {
+            n *= base;
+        }
+        if (n == group) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static uint32_t group_start(struct gen *gen, uint32_t group) {
+    return gen->first_data_block + group * gen->bpg;
+}
+
+static void mark_block(struct gen *gen, uint32_t block_id) {
+    uint32_t i = block_id - gen->first_data_block;
+    set_bit(gen->block_bitmap, i);
+    gen->gdt[i / gen->bpg].bg_free_blocks_count--;
+}
+
+/* Allocate the next free block. With fragmentation, free blocks are
+ * skipped at random and stay free, which breaks the bitmaps into short
+ * runs.
+ */
+static uint32_t alloc_block(struct gen *gen) {
+    for (;;) {
+        uint32_t block_id = gen->next_block++;
+        if (block_id >= gen->blocks_count) {
+            die("Image is full!");
+        }
+        if (test_bit(gen->block_bitmap, block_id - gen->first_data_block)) {
+            continue;
+        }
+        if (gen->frag && (int) (rng_next(gen) % 100) < gen->frag) {
+            continue;
+        }
+        mark_block(gen, block_id);
+        return block_id;
+    }
+}
+
+static void mark_inode(struct gen *gen, uint32_t inode_id, int is_dir) {
+    struct ext2_group_desc *gd = &gen->gdt[(inode_id - 1) / gen->ipg];
+    set_bit(gen->inode_bitmap, inode_id - 1);
+    gd->bg_free_inodes_count--;
+    if (is_dir) {
+        gd->bg_used_dirs_count++;
+    }
+}
+
+static uint32_t alloc_inode(struct gen *gen, int is_dir) {
+    if (gen->next_inode > gen->inodes_count) {
+        die("Out of inodes!");
+    }
+    uint32_t inode_id = gen->next_inode++;
+    mark_inode(gen, inode_id, is_dir);
+    return inode_id;
+}
+
+static void write_inode(struct gen *gen, uint32_t inode_id, const struct ext2_inode *inode) {
+    uint32_t index = inode_id - 1;
+    off_t offset = (off_t) gen->gdt[index / gen->ipg].bg_inode_table * gen->bs +
+            (off_t) (index % gen->ipg) * INODE_SIZE;
+    write_at(gen, inode, sizeof(*inode), offset);
+}
+
+static struct node *node_create(struct gen *gen, struct filemap *map, int level) {
+    struct node *node = xcalloc(1, sizeof(*node));
+    node->block = alloc_block(gen);
+    node->ptrs = xcalloc(gen->ptrs, sizeof(uint32_t));
+    if (level > 1) {
+        node->kids = xcalloc(gen->ptrs, sizeof(struct node *));
+    }
+    map->num_blocks++;
+    return node;
+}
+
+/* Write out an indirect tree and free it */
+static void node_flush(struct gen *gen, struct node *node) {
+    if (node == NULL) {
+        return;
+    }
+    write_block(gen, node->block, node->ptrs);
+    if (node->kids) {
+        for (uint32_t i = 0; i < gen->ptrs; i++) {
+            node_flush(gen, node->kids[i]);
+        }
+    }
+    free(node->kids);
+    free(node->ptrs);
+    free(node);
+}
+
+/* Allocate the data block at logical block lbo of a file, along with the
+ * indirect blocks leading to it. Indirect blocks come first on disk, as
+ * the kernel would lay them out.
+ */
+static uint32_t map_alloc(struct gen *gen, struct filemap *map, uint64_t lbo) {
+    if (lbo < EXT2_NDIR_BLOCKS) {
+        map->i_block[lbo] = alloc_block(gen);
+        map->num_blocks++;
+        return map->i_block[lbo];
+    }
+
+    lbo -= EXT2_NDIR_BLOCKS;
+    uint64_t span = gen->ptrs;
+    for (int level = 1; level <= 3; level++) {
+        if (lbo >= span) {
+            lbo -= span;
+            span *= gen->ptrs;
+            continue;
+        }
+
+        if (map->ind[level - 1] == NULL) {
+            map->ind[level - 1] = node_create(gen, map, level);
+            map->i_block[EXT2_NDIR_BLOCKS + level - 1] = map->ind[level - 1]->block;
+        }
+
+        struct node *node = map->ind[level - 1];
+        for (int l = level; l > 1; l--) {
+            span /= gen->ptrs;
+            uint32_t i = lbo / span;
+            lbo %= span;
+            if (node->kids[i] == NULL) {
+                node->kids[i] = node_create(gen, map, l - 1);
+                node->ptrs[i] = node->kids[i]->block;
+            }
+            node = node->kids[i];
+        }
+
+        node->ptrs[lbo] = alloc_block(gen);
+        map->num_blocks++;
+        return node->ptrs[lbo];
+    }
+
+    die("File too large!");
+    return 0;
+}
+
+static void map_flush(struct gen *gen, struct filemap *map) {
+    for (int level = 0; level < 3; level++) {
+        node_flush(gen, map->ind[level]);
+        map->ind[level] = NULL;
+    }
+}
+
+static void init_inode(struct gen *gen, struct ext2_inode *inode, uint16_t mode,
+        uint64_t size, const struct filemap *map, uint16_t links) {
+    memset(inode, 0, sizeof(*inode));
+    inode->i_mode = mode;
+    inode->i_size = (uint32_t) size;
+    inode->i_size_high = size >> 32;
+    inode->i_atime = IMAGE_TIME;
+    inode->i_ctime = IMAGE_TIME;
+    inode->i_mtime = IMAGE_TIME;
+    inode->i_links_count = links;
+    if (map) {
+        inode->i_blocks = map->num_blocks * (gen->bs / 512);
+        memcpy(inode->i_block, map->i_block, sizeof(inode->i_block));
+    }
+}
+
+/* Create a regular file whose data sits at the given logical blocks. The
+ * data blocks are allocated but never written.
+ */
+static uint32_t make_file(struct gen *gen, const uint64_t *lbos, size_t n, uint64_t size) {
+    uint32_t inode_id = alloc_inode(gen, 0);
+    struct filemap map;
+    memset(&map, 0, sizeof(map));
+
+    for (size_t i = 0; i < n; i++) {
+        map_alloc(gen, &map, lbos[i]);
+    }
+    map_flush(gen, &map);
+
+    struct ext2_inode inode;
+    init_inode(gen, &inode, S_IFREG | 0644, size, &map, 1);
+    write_inode(gen, inode_id, &inode);
+    return inode_id;
+}
+
+static void dir_new_block(struct gen *gen, struct dir *dir) {
+    dir->block_id = map_alloc(gen, &dir->map, dir->lbo);
+    memset(dir->block, 0, gen->bs);
+    dir->used = 0;
+    dir->last = 0;
+}
+
+static void dir_write_block(struct gen *gen, struct dir *dir) {
+    /* NOTE: The last entry of a block covers the rest of it */
+    struct ext2_dir_entry *last = (void *) (dir->block + dir->last);
+    last->rec_len = gen->bs - dir->last;
+    write_block(gen, dir->block_id, dir->block);
+}
+
+static void dir_add(struct gen *gen, struct dir *dir, uint32_t inode_id, const char *name) {
+    int name_len = strlen(name);
+    int rec_len = (8 + name_len + 3) & ~3;
+
+    if (dir->used + rec_len > gen->bs) {
+        dir_write_block(gen, dir);
+        dir->lbo++;
+        dir_new_block(gen, dir);
+    }
+
+    struct ext2_dir_entry *entry = (void *) (dir->block + dir->used);
+    entry->inode = inode_id;
+    entry->rec_len = rec_len;
+    entry->name_len = name_len;
+    memcpy(entry->name, name, name_len);
+    dir->last = dir->used;
+    dir->used += rec_len;
+}
+
+static void dir_open(struct gen *gen, struct dir *dir, uint32_t inode_id, uint32_t parent_id) {
+    memset(dir, 0, sizeof(*dir));
+    dir->inode_id = inode_id;
+    dir->block = xcalloc(1, gen->bs);
+    dir->links = 2;
+    dir_new_block(gen, dir);
+    dir_add(gen, dir, inode_id, ".");
+    dir_add(gen, dir, parent_id, "..");
+}
+
+static void dir_close(struct gen *gen, struct dir *dir) {
+    dir_write_block(gen, dir);
+    map_flush(gen, &dir->map);
+
+    struct ext2_inode inode;
+    init_inode(gen, &inode, S_IFDIR | 0755, (dir->lbo + 1) * gen->bs, &dir->map, dir->links);
+    write_inode(gen, dir->inode_id, &inode);
+    free(dir->block);
+}
+
+/* Create a subdirectory of parent and open it */
+static void dir_mkdir(struct gen *gen, struct dir *parent, struct dir *dir, const char *name) {
+    uint32_t inode_id = alloc_inode(gen, 1);
+    dir_add(gen, parent, inode_id, name);
+    parent->links++;
+    dir_open(gen, dir, inode_id, parent->inode_id);
+}
+
+static void setup_groups(struct gen *gen) {
+    gen->gdt = xcalloc(gen->groups, sizeof(struct ext2_group_desc));
+    gen->block_bitmap = xcalloc((uint64_t) gen->groups * gen->bpg / 8, 1);
+    gen->inode_bitmap = xcalloc((uint64_t) gen->groups * gen->ipg / 8, 1);
+
+    for (uint32_t g = 0; g < gen->groups; g++) {
+        struct ext2_group_desc *gd = &gen->gdt[g];
+        uint32_t block_id = group_start(gen, g);
+        gd->bg_free_blocks_count = gen->bpg;
+        gd->bg_free_inodes_count = gen->ipg;
+
+        if (has_super(g)) {
+            for (uint32_t i = 0; i < 1 + gen->gdt_blocks; i++) {
+                mark_block(gen, block_id++);
+            }
+        }
+        gd->bg_block_bitmap = block_id;
+        mark_block(gen, block_id++);
+        gd->bg_inode_bitmap = block_id;
+        mark_block(gen, block_id++);
+        gd->bg_inode_table = block_id;
+        for (uint32_t i = 0; i < gen->itable_blocks; i++) {
+            mark_block(gen, block_id++);
+        }
+    }
+
+    /* NOTE: Inodes below the first non-reserved one are always in use */
+    for (uint32_t inode_id = 1; inode_id < EXT2_GOOD_OLD_FIRST_INO; inode_id++) {
+        mark_inode(gen, inode_id, inode_id == EXT2_ROOT_INO);
+    }
+    gen->next_inode = EXT2_GOOD_OLD_FIRST_INO;
+    gen->next_block = gen->first_data_block;
+}
+
+static void write_metadata(struct gen *gen) {
+    unsigned char *buf = xcalloc(1, gen->bs);
+    uint32_t free_blocks = 0;
+    uint32_t free_inodes = 0;
+
+    for (uint32_t g = 0; g < gen->groups; g++) {
+        struct ext2_group_desc *gd = &gen->gdt[g];
+        free_blocks += gd->bg_free_blocks_count;
+        free_inodes += gd->bg_free_inodes_count;
+
+        write_block(gen, gd->bg_block_bitmap, gen->block_bitmap + (uint64_t) g * gen->bpg / 8);
+
+        /* NOTE: Bits past the last inode of the group must be set */
+        memset(buf, 0xFF, gen->bs);
+        memcpy(buf, gen->inode_bitmap + (uint64_t) g * gen->ipg / 8, gen->ipg / 8);
+        write_block(gen, gd->bg_inode_bitmap, buf);
+    }
+
+    struct ext2_super_block sb;
+    memset(&sb, 0, sizeof(sb));
+    sb.s_inodes_count = gen->inodes_count;
+    sb.s_blocks_count = gen->blocks_count;
+    sb.s_free_blocks_count = free_blocks;
+    sb.s_free_inodes_count = free_inodes;
+    sb.s_first_data_block = gen->first_data_block;
+    sb.s_log_block_size = gen->bs == 1024 ? 0 : gen->bs == 2048 ? 1 : 2;
+    sb.s_log_frag_size = sb.s_log_block_size;
+    sb.s_blocks_per_group = gen->bpg;
+    sb.s_frags_per_group = gen->bpg;
+    sb.s_inodes_per_group = gen->ipg;
+    sb.s_wtime = IMAGE_TIME;
+    sb.s_max_mnt_count = -1;
+    sb.s_magic = EXT2_SUPER_MAGIC;
+    sb.s_state = 1;         /* Cleanly unmounted */
+    sb.s_errors = 1;        /* Continue */
+    sb.s_lastcheck = IMAGE_TIME;
+    sb.s_rev_level = 1;     /* Dynamic inode sizes and features */
+    sb.s_first_ino = EXT2_GOOD_OLD_FIRST_INO;
+    sb.s_inode_size = INODE_SIZE;
+    sb.s_feature_ro_compat = EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER |
+            EXT2_FEATURE_RO_COMPAT_LARGE_FILE;
+
+    size_t gdt_size = (size_t) gen->gdt_blocks * gen->bs;
+    unsigned char *gdt = xcalloc(1, gdt_size);
+    memcpy(gdt, gen->gdt, gen->groups * sizeof(struct ext2_group_desc));
+
+    for (uint32_t g = 0; g < gen->groups; g++) {
+        if (!has_super(g)) {
+            continue;
+        }
+        uint32_t start = group_start(gen, g);
+        off_t sb_offset = g == 0 ? 1024 : (off_t) start * gen->bs;
+        sb.s_block_group_nr = g;
+        write_at(gen, &sb, sizeof(sb), sb_offset);
+        write_at(gen, gdt, gdt_size, (off_t) (start + 1) * gen->bs);
+    }
+
+    free(gdt);
+    free(buf);
+}
+
+/* Logical blocks of a deep file: every pointer of the single indirect
+ * block, and one data block under every pointer of the double and triple
+ * indirect blocks. Each file then needs 3 + 3 * ptrs indirect blocks and
+ * ends in the last triple indirect subtree.
+ */
+static size_t deep_lbos(struct gen *gen, uint64_t *lbos) {
+    size_t n = 0;
+    for (uint64_t lbo = 0; lbo < EXT2_NDIR_BLOCKS; lbo++) {
+        lbos[n++] = lbo;
+    }
+
+    uint64_t start = EXT2_NDIR_BLOCKS;
+    uint64_t span = 1;
+    for (int level = 1; level <= 3; level++) {
+        for (uint32_t i = 0; i < gen->ptrs; i++) {
+            lbos[n++] = start + i * span;
+        }
+        start += span * gen->ptrs;
+        span *= gen->ptrs;
+    }
+    return n;
+}
+
+static void build_tree(struct gen *gen, const struct params *p) {
+    char name[32];
+    struct dir root;
+    struct dir dir;
+
+    mark_inode(gen, EXT2_GOOD_OLD_FIRST_INO, 1);
+    gen->next_inode = EXT2_GOOD_OLD_FIRST_INO + 1;
+    dir_open(gen, &root, EXT2_ROOT_INO, EXT2_ROOT_INO);
+
+    dir_add(gen, &root, EXT2_GOOD_OLD_FIRST_INO, "lost+found");
+    root.links++;
+    dir_open(gen, &dir, EXT2_GOOD_OLD_FIRST_INO, EXT2_ROOT_INO);
+    dir_close(gen, &dir);
+
+    uint64_t *lbos = xcalloc(EXT2_NDIR_BLOCKS + 3 * (uint64_t) gen->ptrs +
+            p->file_blocks + 1, sizeof(uint64_t));
+
+    uint32_t file = 0;
+    for (uint32_t d = 0; d < p->dirs; d++) {
+        snprintf(name, sizeof(name), "d%06u", d);
+        dir_mkdir(gen, &root, &dir, name);
+
+        uint32_t end = (uint64_t) p->files * (d + 1) / p->dirs;
+        for (; file < end; file++) {
+            uint32_t n = rng_next(gen) % (p->file_blocks + 1);
+            uint64_t size = n ? (uint64_t) (n - 1) * gen->bs + 1 + rng_next(gen) % gen->bs : 0;
+            for (uint32_t i = 0; i < n; i++) {
+                lbos[i] = i;
+            }
+            snprintf(name, sizeof(name), "f%08u", file);
+            dir_add(gen, &dir, make_file(gen, lbos, n, size), name);
+        }
+
+        dir_close(gen, &dir);
+    }
+
+    if (p->huge) {
+        dir_mkdir(gen, &root, &dir, "huge");
+        for (uint32_t i = 0; i < p->huge; i++) {
+            snprintf(name, sizeof(name), "e%08u", i);
+            dir_add(gen, &dir, make_file(gen, NULL, 0, 0), name);
+        }
+        dir_close(gen, &dir);
+    }
+
+    if (p->deep) {
+        dir_mkdir(gen, &root, &dir, "deep");
+        size_t n = deep_lbos(gen, lbos);
+        for (uint32_t i = 0; i < p->deep; i++) {
+            snprintf(name, sizeof(name), "t%06u", i);
+            dir_add(gen, &dir, make_file(gen, lbos, n, (lbos[n - 1] + 1) * gen->bs), name);
+        }
+        dir_close(gen, &dir);
+    }
+
+    dir_close(gen, &root);
+    free(lbos);
+}
+
+static void usage(void) {
+    fprintf(stderr, "Usage: ./mkimage [-b BLOCK_SIZE] [-g GROUPS] [-i INODES_PER_GROUP] "
+            "[-d DIRS] [-n FILES] [-m FILE_BLOCKS] [-H HUGE_DIR_ENTRIES] [-T DEEP_FILES] "
+            "[-f FRAG_PERCENT] [-s SEED] image\n");
+    exit(1);
+}
+
+static uint32_t parse_u32(const char *arg) {
+    char *end;
+    unsigned long v = strtoul(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0' || v > UINT32_MAX) {
+        usage();
+    }
+    return v;
+}
+
+int main(int argc, char *argv[]) {
+    struct params p;
+    p.block_size = 1024;
+    p.groups = 8;
+    p.inodes_per_group = 0;
+    p.dirs = 16;
+    p.files = 1000;
+    p.file_blocks = 16;
+    p.huge = 0;
+    p.deep = 0;
+    p.frag = 0;
+    p.seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:g:i:d:n:m:H:T:f:s:")) != -1) {
+        switch (opt) {
+            case 'b':
+                p.block_size = parse_u32(optarg);
+                break;
+            case 'g':
+                p.groups = parse_u32(optarg);
+                break;
+            case 'i':
+                p.inodes_per_group = parse_u32(optarg);
+                break;
+            case 'd':
+                p.dirs = parse_u32(optarg);
+                break;
+            case 'n':
+                p.files = parse_u32(optarg);
+                break;
+            case 'm':
+                p.file_blocks = parse_u32(optarg);
+                break;
+            case 'H':
+                p.huge = parse_u32(optarg);
+                break;
+            case 'T':
+                p.deep = parse_u32(optarg);
+                break;
+            case 'f':
+                p.frag = parse_u32(optarg);
+                break;
+            case 's':
+                p.seed = parse_u32(optarg);
+                break;
+            default:
+                usage();
+        }
+    }
+    if (optind != argc - 1) {
+        usage();
+    }
+    if ((p.block_size != 1024 && p.block_size != 2048 && p.block_size != 4096) ||
+            p.groups == 0 || p.frag > 90 || (p.files > 0 && p.dirs == 0)) {
+        usage();
+    }
+
+    struct gen gen;
+    memset(&gen, 0, sizeof(gen));
+    gen.bs = p.block_size;
+    gen.ptrs = gen.bs / sizeof(uint32_t);
+    gen.first_data_block = gen.bs == 1024 ? 1 : 0;
+    gen.bpg = 8 * gen.bs;
+    gen.groups = p.groups;
+    gen.frag = p.frag;
+    gen.rng = p.seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    /* NOTE: Inode tables fill whole blocks and bitmaps whole bytes */
+    uint32_t per_block = gen.bs / INODE_SIZE;
+    uint32_t ipg = p.inodes_per_group;
+    if (ipg == 0) {
+        uint64_t needed = (uint64_t) p.files + p.huge + p.deep + p.dirs + 64;
+        ipg = (needed + p.groups - 1) / p.groups;
+    }
+    ipg = (ipg + per_block - 1) / per_block * per_block;
+    ipg = (ipg + 7) / 8 * 8;
+    if (ipg < 16) {
+        ipg = 16;
+    }
+    if (ipg > gen.bpg) {
+        fprintf(stderr, "Too many inodes per group!\n");
+        exit(1);
+    }
+    gen.ipg = ipg;
+
+    uint64_t blocks_count = gen.first_data_block + (uint64_t) p.groups * gen.bpg;
+    uint64_t inodes_count = (uint64_t) p.groups * gen.ipg;
+    if (blocks_count > UINT32_MAX || inodes_count > UINT32_MAX) {
+        fprintf(stderr, "Image too large!\n");
+        exit(1);
+    }
+    gen.blocks_count = blocks_count;
+    gen.inodes_count = inodes_count;
+    gen.gdt_blocks = (p.groups * sizeof(struct ext2_group_desc) + gen.bs - 1) / gen.bs;
+    gen.itable_blocks = gen.ipg / per_block;
+    if (2 + gen.gdt_blocks + 2 + gen.itable_blocks >= gen.bpg) {
+        fprintf(stderr, "Groups too small for their metadata!\n");
+        exit(1);
+    }
+
+    gen.fd = open(argv[optind], O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (gen.fd == -1) {
+        fprintf(stderr, "Unable to create %s!\n", argv[optind]);
+        exit(1);
+    }
+    if (ftruncate(gen.fd, (off_t) blocks_count * gen.bs) == -1) {
+        die("Unable to size image!");
+    }
+
+    setup_groups(&gen);
+    build_tree(&gen, &p);
+    write_metadata(&gen);
+
+    if (close(gen.fd) == -1) {
+        die("Unable to write image!");
+    }
+    free(gen.gdt);
+    free(gen.block_bitmap);
+    free(gen.inode_bitmap);
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "outbuf.h"
+
+#define OUTBUF_MIN_GROW 4096
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* Set up a buffer of cap bytes. In-memory buffers (fd of -1) allocate
+ * lazily, so a cap of zero is fine for them.
+ *
+ * Return 0 on success, -1 on error
+ */
+int outbuf_init(struct outbuf *ob, int fd, size_t cap) {
+    ob->buf = NULL;
+    ob->len = 0;
+    ob->cap = 0;
+    ob->fd = fd;
+    ob->error = 0;
+
+    if (cap > 0) {
+        ob->buf = malloc(cap);
+        if (ob->buf == NULL) {
+            ob->error = 1;
+            return -1;
+        }
+        ob->cap = cap;
+    }
+
+    return 0;
+}
+
+void outbuf_free(struct outbuf *ob) {
+    free(ob->buf);
+    ob->buf = NULL;
+    ob->len = 0;
+    ob->cap = 0;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+/* Write out a buffer attached to a file descriptor.
+ *
+ * Return 0 on success, -1 on error
+ */
+int outbuf_flush(struct outbuf *ob) {
+    if (ob->fd == -1 || ob->len == 0) {
+        return ob->error ? -1 : 0;
+    }
+
+    if (write_all(ob->fd, ob->buf, ob->len) == -1) {
+        ob->error = 1;
+    }
+    ob->len = 0;
+
+    return ob->error ? -1 : 0;
+}
+
+/* Make room for n bytes, either by flushing or by growing the buffer.
+ *
+ * Return NULL on error
+ */
+char *outbuf_reserve_slow(struct outbuf *ob, size_t n) {
+    if (ob->error) {
+        return NULL;
+    }
+
+    if (ob->fd != -1 && ob->cap >= n) {
+        if (outbuf_flush(ob) == -1) {
+            return NULL;
+        }
+        return ob->buf;
+    }
+
+    size_t cap = ob->cap ? ob->cap : OUTBUF_MIN_GROW;
+    while (cap - ob->len < n) {
+        cap *= 2;
+    }
+
+    char *buf = realloc(ob->buf, cap);
+    if (buf == NULL) {
+        ob->error = 1;
+        return NULL;
+    }
+    ob->buf = buf;
+    ob->cap = cap;
+
+    return ob->buf + ob->len;
+}
+
+/* Write the contents of in-memory buffers to fd in order, batching them
+ * into as few writev calls as possible.
+ *
+ * Return 0 on success, -1 on error
+ */
+int outbuf_writev(int fd, struct outbuf **bufs, size_t n) {
+    struct iovec iov[64];
+    int rc = 0;
+    size_t i = 0;
+
+    while (i < n) {
+        int cnt = 0;
+        size_t total = 0;
+        while (i < n && cnt < 64) {
+            if (bufs[i]->error) {
+                rc = -1;
+            }
+            if (bufs[i]->len > 0) {
+                iov[cnt].iov_base = bufs[i]->buf;
+                iov[cnt].iov_len = bufs[i]->len;
+                total += bufs[i]->len;
+                cnt++;
+            }
+            i++;
+        }
+
+        /* NOTE: writev may write less than requested, so finish off any
+         * partially written batch buffer by buffer
+         */
+        struct iovec *v = iov;
+        while (cnt > 0 && total > 0) {
+            ssize_t written = writev(fd, v, cnt);
+            if (written == -1 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return -1;
+            }
+            total -= written;
+            while (cnt > 0 && (size_t) written >= v->iov_len) {
+                written -= v->iov_len;
+                v++;
+                cnt--;
+            }
+            if (cnt > 0) {
+                v->iov_base = (char *) v->iov_base + written;
+                v->iov_len -= written;
+            }
+        }
+    }
+
+    return rc;
+}
+
+void outbuf_put_u64(struct outbuf *ob, uint64_t v) {
+    char tmp[20];
+    char *end = tmp + sizeof(tmp);
+    char *p = end;
+
+    while (v >= 100) {
+        unsigned idx = (v % 100) * 2;
+        v /= 100;
+        p -= 2;
+        p[0] = digit_pairs[idx];
+        p[1] = digit_pairs[idx + 1];
+    }
+    if (v >= 10) {
+        p -= 2;
+        p[0] = digit_pairs[v * 2];
+        p[1] = digit_pairs[v * 2 + 1];
+    } else {
+        *--p = '0' + v;
+    }
+
+    outbuf_put_mem(ob, p, end - p);
+}
+
+void outbuf_put_i64(struct outbuf *ob, int64_t v) {
+    if (v < 0) {
+        outbuf_put_char(ob, '-');
+        outbuf_put_u64(ob, -(uint64_t) v);
+        return;
+    }
+    outbuf_put_u64(ob, v);
+}
+
+void outbuf_put_octal(struct outbuf *ob, uint32_t v) {
+    char tmp[11];
+    char *end = tmp + sizeof(tmp);
+    char *p = end;
+
+    do {
+        *--p = '0' + (v & 7);
+        v >>= 3;
+    } while (v);
+
+    outbuf_put_mem(ob, p, end - p);
+}
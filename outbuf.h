@@ -0,0 +1,77 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Buffered record writer.
+ *
+ * A buffer attached to a file descriptor is flushed with write whenever it
+ * fills up. A buffer without one (fd of -1) grows in memory instead; those
+ * are used per group/thread and written out in order with outbuf_writev.
+ */
+
+#define OUTBUF_DEFAULT_SIZE (1 << 20)
+
+struct outbuf {
+    char *buf;
+    size_t len;
+    size_t cap;
+    int fd;
+    int error;      /* Set once a write or allocation failed */
+};
+
+int outbuf_init(struct outbuf *ob, int fd, size_t cap);
+void outbuf_free(struct outbuf *ob);
+int outbuf_flush(struct outbuf *ob);
+int outbuf_writev(int fd, struct outbuf **bufs, size_t n);
+
+char *outbuf_reserve_slow(struct outbuf *ob, size_t n);
+
+/* Return a pointer to at least n writable bytes at the end of the buffer */
+static inline char *outbuf_reserve(struct outbuf *ob, size_t n) {
+    if (ob->cap - ob->len >= n) {
+        return ob->buf + ob->len;
+    }
+    return outbuf_reserve_slow(ob, n);
+}
+
+static inline void outbuf_put_mem(struct outbuf *ob, const void *data, size_t n) {
+    char *p = outbuf_reserve(ob, n);
+    if (p) {
+        memcpy(p, data, n);
+        ob->len += n;
+    }
+}
+
+static inline void outbuf_put_char(struct outbuf *ob, char c) {
+    char *p = outbuf_reserve(ob, 1);
+    if (p) {
+        *p = c;
+        ob->len++;
+    }
+}
+
+static inline void outbuf_put_str(struct outbuf *ob, const char *s) {
+    outbuf_put_mem(ob, s, strlen(s));
+}
+
+void outbuf_put_u64(struct outbuf *ob, uint64_t v);
+void outbuf_put_i64(struct outbuf *ob, int64_t v);
+void outbuf_put_octal(struct outbuf *ob, uint32_t v);
+
+static inline void outbuf_put_u32(struct outbuf *ob, uint32_t v) {
+    outbuf_put_u64(ob, v);
+}
+
+static inline void outbuf_put_i32(struct outbuf *ob, int32_t v) {
+    outbuf_put_i64(ob, v);
+}
+
+#endif
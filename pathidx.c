@@ -0,0 +1,428 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "pathidx.h"
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+/* Corrupted file systems may contain directory loops, so give up on paths
+ * with more components than this
+ */
+#define MAX_PATH_DEPTH 4096
+
+/* Bump allocator for names. Chunks are never moved, so names stay put
+ * while the lists pointing at them grow.
+ */
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+struct path_entry {
+    uint32_t dir_id;
+    uint32_t inode_id;
+    uint64_t offset;        /* Byte offset of the entry in its directory */
+    const char *name;
+    uint32_t name_len;
+};
+
+/* Entries recorded by one thread */
+struct entry_list {
+    struct path_entry *entries;
+    size_t len;
+    size_t cap;
+    struct arena_chunk *names;
+};
+
+struct pathidx {
+    struct fs *fs;
+    _Atomic uint64_t *is_dir;       /* Bitmap indexed by inode number - 1 */
+    struct entry_list *slots;
+    int num_slots;
+
+    /* Filled in by pathidx_build */
+    struct path_entry *entries;     /* All entries in directory order */
+    size_t num_entries;
+    size_t *group_offsets;          /* First entry of each group */
+    uint32_t *table;                /* Entry index + 1, 0 for an empty slot */
+    size_t table_mask;
+    uint32_t *dir_entries;          /* Entry index + 1 naming each directory */
+};
+
+static const char *arena_copy(struct arena_chunk **head, const char *s, size_t len) {
+    struct arena_chunk *chunk = *head;
+
+    if (chunk == NULL || chunk->size - chunk->used < len) {
+        size_t size = len > ARENA_CHUNK_SIZE ? len : ARENA_CHUNK_SIZE;
+        chunk = malloc(sizeof(*chunk) + size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->next = *head;
+        chunk->used = 0;
+        chunk->size = size;
+        *head = chunk;
+    }
+
+    char *p = chunk->data + chunk->used;
+    memcpy(p, s, len);
+    chunk->used += len;
+    return p;
+}
+
+static void arena_free(struct arena_chunk *chunk) {
+    while (chunk) {
+        struct arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+/* FNV-1a over the name, seeded with the directory */
+static uint64_t entry_hash(uint32_t dir_id, const char *name, size_t name_len) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ ((uint64_t) dir_id * 0x9e3779b97f4a7c15ULL);
+
+    for (size_t i = 0; i < name_len; i++) {
+        h ^= (unsigned char) name[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h ^ (h >> 32);
+}
+
+/* Create an index filled by up to num_slots threads at a time */
+struct pathidx *pathidx_create(struct fs *fs, int num_slots) {
+    struct pathidx *idx = calloc(1, sizeof(*idx));
+    if (idx == NULL) {
+        return NULL;
+    }
+    idx->fs = fs;
+    idx->is_dir = calloc(fs->sb.s_inodes_count / 64 + 1, sizeof(uint64_t));
+    idx->slots = calloc(num_slots, sizeof(struct entry_list));
+    idx->num_slots = num_slots;
+
+    if (idx->is_dir == NULL || idx->slots == NULL) {
+        pathidx_destroy(idx);
+        return NULL;
+    }
+    return idx;
+}
+
+void pathidx_destroy(struct pathidx *idx) {
+    if (idx == NULL) {
+        return;
+    }
+
+    if (idx->slots) {
+        for (int i = 0; i < idx->num_slots; i++) {
+            free(idx->slots[i].entries);
+            arena_free(idx->slots[i].names);
+        }
+    }
+    free(idx->slots);
+    free(idx->is_dir);
+    free(idx->entries);
+    free(idx->group_offsets);
+    free(idx->table);
+    free(idx->dir_entries);
+    free(idx);
+}
+
+/* Record that an allocated inode is a directory */
+void pathidx_mark_dir(struct pathidx *idx, uint32_t inode_id) {
+    uint64_t mask = (uint64_t) 1 << ((inode_id - 1) % 64);
+    atomic_fetch_or_explicit(&idx->is_dir[(inode_id - 1) / 64], mask, memory_order_relaxed);
+}
+
+static int is_dir(struct pathidx *idx, uint32_t inode_id) {
+    if (inode_id < 1 || inode_id > idx->fs->sb.s_inodes_count) {
+        return 0;
+    }
+    uint64_t word = atomic_load_explicit(&idx->is_dir[(inode_id - 1) / 64], memory_order_relaxed);
+    return (word >> ((inode_id - 1) % 64)) & 1;
+}
+
+/* Record the entry at byte offset offset of directory dir_id. No two
+ * threads may use the same slot at the same time.
+ */
+void pathidx_add(struct pathidx *idx, int slot, uint32_t dir_id, uint64_t offset,
+        uint32_t entry_id, const char *name, int name_len) {
+    if ((name_len == 1 && name[0] == '.') ||
+            (name_len == 2 && name[0] == '.' && name[1] == '.')) {
+        return;
+    }
+
+    struct entry_list *list = &idx->slots[slot];
+    if (list->len == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 256;
+        struct path_entry *entries = realloc(list->entries, cap * sizeof(*entries));
+        if (entries == NULL) {
+            return;
+        }
+        list->entries = entries;
+        list->cap = cap;
+    }
+
+    const char *copy = arena_copy(&list->names, name, name_len);
+    if (copy == NULL) {
+        return;
+    }
+
+    struct path_entry *e = &list->entries[list->len++];
+    e->dir_id = dir_id;
+    e->inode_id = entry_id;
+    e->offset = offset;
+    e->name = copy;
+    e->name_len = name_len;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const struct path_entry *x = a;
+    const struct path_entry *y = b;
+
+    if (x->dir_id != y->dir_id) {
+        return x->dir_id < y->dir_id ? -1 : 1;
+    }
+    if (x->offset != y->offset) {
+        return x->offset < y->offset ? -1 : 1;
+    }
+    return 0;
+}
+
+/* Join the per-slot lists and build the lookup tables. Must run after the
+ * scan has finished.
+ *
+ * Return 0 on success, -1 on error
+ */
+int pathidx_build(struct pathidx *idx) {
+    struct fs *fs = idx->fs;
+
+    idx->group_offsets = malloc((fs->num_groups + 1) * sizeof(size_t));
+    if (idx->group_offsets == NULL) {
+        return -1;
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < idx->num_slots; i++) {
+        n += idx->slots[i].len;
+    }
+    if (n >= UINT32_MAX) {
+        return -1;
+    }
+
+    idx->entries = malloc((n ? n : 1) * sizeof(struct path_entry));
+    idx->dir_entries = calloc(fs->sb.s_inodes_count, sizeof(uint32_t));
+    size_t table_size = 16;
+    while (table_size < n * 2) {
+        table_size *= 2;
+    }
+    idx->table = calloc(table_size, sizeof(uint32_t));
+    if (idx->entries == NULL || idx->dir_entries == NULL || idx->table == NULL) {
+        return -1;
+    }
+    idx->table_mask = table_size - 1;
+
+    size_t pos = 0;
+    for (int i = 0; i < idx->num_slots; i++) {
+        struct entry_list *list = &idx->slots[i];
+        if (list->len > 0) {
+            memcpy(idx->entries + pos, list->entries, list->len * sizeof(struct path_entry));
+            pos += list->len;
+        }
+        free(list->entries);
+        list->entries = NULL;
+        list->len = list->cap = 0;
+    }
+    idx->num_entries = n;
+
+    /* NOTE: Directories are scanned by several threads at once, so put the
+     * entries back in the order of a serial scan
+     */
+    qsort(idx->entries, n, sizeof(struct path_entry), compare_entries);
+
+    size_t first = 0;
+    for (uint32_t g = 0; g < fs->num_groups; g++) {
+        uint64_t end_id = (uint64_t) fs_group_first_inode(fs, g) + fs->sb.s_inodes_per_group;
+        idx->group_offsets[g] = first;
+        while (first < n && idx->entries[first].dir_id < end_id) {
+            first++;
+        }
+    }
+    idx->group_offsets[fs->num_groups] = n;
+
+    /* NOTE: Should a name appear twice in a directory or a directory have
+     * several names, the first one in inode order wins
+     */
+    for (size_t i = 0; i < n; i++) {
+        struct path_entry *e = &idx->entries[i];
+        if (pathidx_lookup(idx, e->dir_id, e->name, e->name_len) == 0) {
+            size_t slot = entry_hash(e->dir_id, e->name, e->name_len) & idx->table_mask;
+            while (idx->table[slot] != 0) {
+                slot = (slot + 1) & idx->table_mask;
+            }
+            idx->table[slot] = i + 1;
+        }
+
+        if (is_dir(idx, e->inode_id) && idx->dir_entries[e->inode_id - 1] == 0) {
+            idx->dir_entries[e->inode_id - 1] = i + 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Return the inode of the entry called name in directory dir_id, or 0 if
+ * there is none
+ */
+uint32_t pathidx_lookup(struct pathidx *idx, uint32_t dir_id, const char *name, int name_len) {
+    size_t slot = entry_hash(dir_id, name, name_len) & idx->table_mask;
+
+    while (idx->table[slot] != 0) {
+        struct path_entry *e = &idx->entries[idx->table[slot] - 1];
+        if (e->dir_id == dir_id && e->name_len == (uint32_t) name_len &&
+                memcmp(e->name, name, name_len) == 0) {
+            return e->inode_id;
+        }
+        slot = (slot + 1) & idx->table_mask;
+    }
+    return 0;
+}
+
+/* Return the directory holding directory dir_id, or 0 if it is unknown */
+static uint32_t parent_of(struct pathidx *idx, uint32_t dir_id) {
+    if (dir_id == EXT2_ROOT_INO) {
+        return EXT2_ROOT_INO;
+    }
+
+    uint32_t entry = idx->dir_entries[dir_id - 1];
+    return entry ? idx->entries[entry - 1].dir_id : 0;
+}
+
+/* Return the inode a path refers to, or 0 if it does not exist. Paths are
+ * taken relative to the root directory.
+ */
+uint32_t pathidx_resolve(struct pathidx *idx, const char *path) {
+    uint32_t inode_id = EXT2_ROOT_INO;
+
+    while (*path) {
+        const char *end = strchr(path, '/');
+        size_t len = end ? (size_t) (end - path) : strlen(path);
+
+        if (len == 0 || (len == 1 && path[0] == '.')) {
+            /* Nothing to do */
+        } else if (!is_dir(idx, inode_id) || len > EXT2_NAME_LEN) {
+            return 0;
+        } else if (len == 2 && path[0] == '.' && path[1] == '.') {
+            inode_id = parent_of(idx, inode_id);
+        } else {
+            inode_id = pathidx_lookup(idx, inode_id, path, len);
+        }
+
+        if (inode_id == 0) {
+            return 0;
+        }
+        path += len;
+        if (*path == '/') {
+            path++;
+        }
+    }
+
+    return inode_id;
+}
+
+/* Append the path of an entry to out.
+ *
+ * Return 0 on success, -1 if the entry cannot be reached from the root
+ */
+static int put_path(struct pathidx *idx, struct outbuf *out, size_t entry) {
+    uint32_t stack[MAX_PATH_DEPTH];
+    int depth = 0;
+
+    stack[depth++] = entry;
+    uint32_t dir_id = idx->entries[entry].dir_id;
+    while (dir_id != EXT2_ROOT_INO) {
+        uint32_t parent = idx->dir_entries[dir_id - 1];
+        if (parent == 0 || depth == MAX_PATH_DEPTH) {
+            return -1;
+        }
+        stack[depth++] = parent - 1;
+        dir_id = idx->entries[parent - 1].dir_id;
+    }
+
+    while (depth > 0) {
+        struct path_entry *e = &idx->entries[stack[--depth]];
+        outbuf_put_char(out, '/');
+        outbuf_put_mem(out, e->name, e->name_len);
+    }
+    return 0;
+}
+
+struct print_ctx {
+    struct pathidx *idx;
+    struct outbuf *bufs;    /* One buffer per group */
+};
+
+static void print_group(void *arg, size_t group) {
+    struct print_ctx *ctx = arg;
+    struct pathidx *idx = ctx->idx;
+    struct outbuf *out = &ctx->bufs[group];
+
+    outbuf_init(out, -1, 0);
+    for (size_t i = idx->group_offsets[group]; i < idx->group_offsets[group + 1]; i++) {
+        size_t start = out->len;
+        outbuf_put_str(out, "PATH,");
+        outbuf_put_u32(out, idx->entries[i].inode_id);
+        outbuf_put_str(out, ",'");
+        if (put_path(idx, out, i) == -1) {
+            out->len = start;
+            continue;
+        }
+        outbuf_put_str(out, "'\n");
+    }
+}
+
+/* Print the path of every directory entry reachable from the root:
+ * PATH
+ * inode number of the referenced file (decimal)
+ * path from the root (string, surrounded by single-quotes)
+ *
+ * Files with several hard links get one record per name.
+ */
+void pathidx_print(struct pathidx *idx, struct pool *pool, struct outbuf *out) {
+    uint32_t num_groups = idx->fs->num_groups;
+
+    struct print_ctx ctx;
+    ctx.idx = idx;
+    ctx.bufs = calloc(num_groups, sizeof(struct outbuf));
+    struct outbuf **order = calloc(num_groups, sizeof(struct outbuf *));
+    if (ctx.bufs == NULL || order == NULL) {
+        free(ctx.bufs);
+        free(order);
+        out->error = 1;
+        return;
+    }
+
+    outbuf_put_str(out, "PATH,2,'/'\n");
+
+    pool_for(pool, num_groups, print_group, &ctx);
+
+    for (uint32_t g = 0; g < num_groups; g++) {
+        order[g] = &ctx.bufs[g];
+    }
+    outbuf_flush(out);
+    if (outbuf_writev(out->fd, order, num_groups) == -1) {
+        out->error = 1;
+    }
+
+    for (uint32_t g = 0; g < num_groups; g++) {
+        outbuf_free(&ctx.bufs[g]);
+    }
+    free(order);
+    free(ctx.bufs);
+}
@@ -0,0 +1,42 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef PATHIDX_H
+#define PATHIDX_H
+
+#include <stdint.h>
+#include "fs.h"
+#include "pool.h"
+#include "outbuf.h"
+
+/* Index from paths to inodes, built from the directory entries seen by the
+ * scan.
+ *
+ * While groups are scanned, pathidx_add records every entry of a directory
+ * in a list owned by the calling thread, with its name copied into an
+ * arena owned by the same thread, so no locking is needed. pathidx_build
+ * then joins the lists in directory order, hashes every entry by
+ * (directory, name) and maps each directory to the entry naming it, which
+ * is its link to its parent.
+ *
+ * Resolving a path takes one hash lookup per component.
+ */
+
+struct pathidx;
+
+struct pathidx *pathidx_create(struct fs *fs, int num_slots);
+void pathidx_destroy(struct pathidx *idx);
+
+void pathidx_mark_dir(struct pathidx *idx, uint32_t inode_id);
+void pathidx_add(struct pathidx *idx, int slot, uint32_t dir_id, uint64_t offset,
+        uint32_t entry_id, const char *name, int name_len);
+int pathidx_build(struct pathidx *idx);
+
+uint32_t pathidx_lookup(struct pathidx *idx, uint32_t dir_id, const char *name, int name_len);
+uint32_t pathidx_resolve(struct pathidx *idx, const char *path);
+
+void pathidx_print(struct pathidx *idx, struct pool *pool, struct outbuf *out);
+
+#endif
@@ -0,0 +1,28 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/* Fixed-size worker thread pool.
+ *
+ * pool_for runs fn(arg, i) for every i in [0, n) on the workers and the
+ * calling thread, and returns once all of them have finished.
+ */
+
+struct pool;
+
+typedef void (*pool_fn)(void *arg, size_t i);
+
+struct pool *pool_create(int num_threads);
+void pool_for(struct pool *pool, size_t n, pool_fn fn, void *arg);
+int pool_size(struct pool *pool);
+void pool_destroy(struct pool *pool);
+
+int pool_default_threads(void);
+
+#endif
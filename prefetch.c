@@ -0,0 +1,315 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "prefetch.h"
+
+/* Largest single read, in bytes. Longer runs are split. */
+#define PREFETCH_MAX_READ (128 * 1024)
+
+/* Submission and completion rings of one io_uring, mapped from the kernel */
+struct uring {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+};
+
+/* Per-worker state. Each read in flight owns one buffer. */
+struct prefetch_slot {
+    struct uring ring;
+    char *bufs;
+    int *free_bufs;
+    int num_free;
+    unsigned queued;        /* Prepared but not submitted yet */
+};
+
+struct prefetch {
+    struct image *img;
+    int depth;
+    int use_uring;
+    struct prefetch_slot *slots;
+    int num_slots;
+};
+
+static int uring_setup(struct uring *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd == -1) {
+        return -1;
+    }
+
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sq_ring == MAP_FAILED || r->cq_ring == MAP_FAILED || r->sqes == MAP_FAILED) {
+        if (r->sq_ring != MAP_FAILED) {
+            munmap(r->sq_ring, r->sq_ring_size);
+        }
+        if (r->cq_ring != MAP_FAILED) {
+            munmap(r->cq_ring, r->cq_ring_size);
+        }
+        if (r->sqes != MAP_FAILED) {
+            munmap(r->sqes, r->sqes_size);
+        }
+        close(r->fd);
+        r->fd = -1;
+        return -1;
+    }
+
+    char *sq = r->sq_ring;
+    char *cq = r->cq_ring;
+    r->sq_head = (unsigned *) (sq + p.sq_off.head);
+    r->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *) (sq + p.sq_off.array);
+    r->cq_head = (unsigned *) (cq + p.cq_off.head);
+    r->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+    return 0;
+}
+
+static void uring_close(struct uring *r) {
+    if (r->fd == -1) {
+        return;
+    }
+    munmap(r->sqes, r->sqes_size);
+    munmap(r->cq_ring, r->cq_ring_size);
+    munmap(r->sq_ring, r->sq_ring_size);
+    close(r->fd);
+    r->fd = -1;
+}
+
+static int uring_enter(struct uring *r, unsigned to_submit, unsigned min_complete) {
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    int rc;
+    do {
+        rc = syscall(__NR_io_uring_enter, r->fd, to_submit, min_complete, flags, NULL, 0);
+    } while (rc == -1 && errno == EINTR);
+    return rc;
+}
+
+/* Hand the buffers of finished reads back to the slot. The data itself is
+ * not needed: the reads only exist to fill the page cache.
+ */
+static void reap(struct prefetch_slot *slot) {
+    struct uring *r = &slot->ring;
+    unsigned head = *r->cq_head;
+    unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        slot->free_bufs[slot->num_free++] = (int) cqe->user_data;
+        head++;
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* Submit the prepared reads, waiting for min_complete of them */
+static void submit(struct prefetch_slot *slot, unsigned min_complete) {
+    int rc = uring_enter(&slot->ring, slot->queued, min_complete);
+    if (rc > 0) {
+        slot->queued -= rc;
+    }
+    reap(slot);
+}
+
+static void queue_read(struct prefetch *pf, struct prefetch_slot *slot, off_t offset,
+        size_t len) {
+    if (slot->num_free == 0) {
+        reap(slot);
+    }
+    if (slot->num_free == 0) {
+        /* NOTE: Every buffer is in flight; wait for the oldest reads */
+        submit(slot, 1);
+        if (slot->num_free == 0) {
+            return;
+        }
+    }
+
+    struct uring *r = &slot->ring;
+    int buf = slot->free_bufs[--slot->num_free];
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = pf->img->fd;
+    sqe->off = offset;
+    sqe->addr = (uintptr_t) (slot->bufs + (size_t) buf * PREFETCH_MAX_READ);
+    sqe->len = len;
+    sqe->user_data = buf;
+
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    slot->queued++;
+}
+
+static void prefetch_run(struct prefetch *pf, struct prefetch_slot *slot, uint32_t block_id,
+        size_t num_blocks) {
+    struct image *img = pf->img;
+    off_t offset = image_block_offset(img, block_id);
+    if (offset >= img->size) {
+        return;
+    }
+
+    off_t len = (off_t) num_blocks * img->block_size;
+    if (len > img->size - offset) {
+        len = img->size - offset;
+    }
+
+    if (!pf->use_uring) {
+        posix_fadvise(img->fd, offset, len, POSIX_FADV_WILLNEED);
+        return;
+    }
+
+    while (len > 0) {
+        size_t n = len < PREFETCH_MAX_READ ? len : PREFETCH_MAX_READ;
+        queue_read(pf, slot, offset, n);
+        offset += n;
+        len -= n;
+    }
+}
+
+/* Create a prefetcher for up to num_slots threads at a time, each with at
+ * most depth reads in flight. Falls back to readahead hints if io_uring
+ * cannot be set up.
+ *
+ * Return NULL on error
+ */
+struct prefetch *prefetch_create(struct image *img, int num_slots, int depth) {
+    struct prefetch *pf = calloc(1, sizeof(*pf));
+    if (pf == NULL) {
+        return NULL;
+    }
+    pf->img = img;
+    pf->depth = depth;
+    pf->num_slots = num_slots;
+    pf->slots = calloc(num_slots, sizeof(struct prefetch_slot));
+    if (pf->slots == NULL) {
+        free(pf);
+        return NULL;
+    }
+
+    pf->use_uring = 1;
+    for (int i = 0; i < num_slots; i++) {
+        struct prefetch_slot *slot = &pf->slots[i];
+        slot->ring.fd = -1;
+        if (!pf->use_uring) {
+            continue;
+        }
+
+        slot->bufs = malloc((size_t) depth * PREFETCH_MAX_READ);
+        slot->free_bufs = malloc(depth * sizeof(int));
+        if (slot->bufs == NULL || slot->free_bufs == NULL ||
+                uring_setup(&slot->ring, depth) == -1) {
+            pf->use_uring = 0;
+            continue;
+        }
+        for (int b = 0; b < depth; b++) {
+            slot->free_bufs[b] = b;
+        }
+        slot->num_free = depth;
+    }
+
+    if (!pf->use_uring) {
+        for (int i = 0; i < num_slots; i++) {
+            uring_close(&pf->slots[i].ring);
+            free(pf->slots[i].bufs);
+            free(pf->slots[i].free_bufs);
+            pf->slots[i].bufs = NULL;
+            pf->slots[i].free_bufs = NULL;
+        }
+    }
+
+    return pf;
+}
+
+void prefetch_destroy(struct prefetch *pf) {
+    if (pf == NULL) {
+        return;
+    }
+    for (int i = 0; i < pf->num_slots; i++) {
+        struct prefetch_slot *slot = &pf->slots[i];
+        if (slot->ring.fd != -1) {
+            /* NOTE: The kernel may still write into buffers in flight */
+            if (slot->queued > 0) {
+                submit(slot, 0);
+            }
+            while (slot->num_free < pf->depth - (int) slot->queued &&
+                    uring_enter(&slot->ring, 0, 1) != -1) {
+                reap(slot);
+            }
+            uring_close(&slot->ring);
+        }
+        free(slot->bufs);
+        free(slot->free_bufs);
+    }
+    free(pf->slots);
+    free(pf);
+}
+
+/* Return 1 if reads go through io_uring, 0 if only readahead hints are used */
+int prefetch_async(struct prefetch *pf) {
+    return pf->use_uring;
+}
+
+/* Start reading the given blocks. Zero entries are skipped and runs of
+ * consecutive blocks are read together. No two threads may use the same
+ * slot at the same time.
+ */
+void prefetch_blocks(struct prefetch *pf, int slot_id, const uint32_t *blocks, size_t n) {
+    struct prefetch_slot *slot = &pf->slots[slot_id];
+    size_t i = 0;
+
+    while (i < n) {
+        if (blocks[i] == 0) {
+            i++;
+            continue;
+        }
+
+        size_t run = 1;
+        while (i + run < n && blocks[i + run] == blocks[i] + run) {
+            run++;
+        }
+        prefetch_run(pf, slot, blocks[i], run);
+        i += run;
+    }
+
+    if (pf->use_uring && slot->queued > 0) {
+        submit(slot, 0);
+    }
+}
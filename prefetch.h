@@ -0,0 +1,37 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "image.h"
+
+/* Asynchronous prefetch of blocks the traversal is about to read.
+ *
+ * As soon as an indirect block is decoded, the blocks it points to that
+ * will be read next (lower level indirect blocks or directory blocks) are
+ * handed to prefetch_blocks. Runs of consecutive blocks are merged and
+ * read through an io_uring owned by the calling worker, with at most
+ * depth reads in flight per worker. The data lands in the page cache,
+ * where the traversal's own reads then find it.
+ *
+ * Without io_uring (old kernels, seccomp) the runs are passed to
+ * posix_fadvise instead, which starts kernel readahead without waiting.
+ */
+
+#define PREFETCH_DEFAULT_DEPTH 32
+#define PREFETCH_MAX_DEPTH 4096
+
+struct prefetch;
+
+struct prefetch *prefetch_create(struct image *img, int num_slots, int depth);
+void prefetch_destroy(struct prefetch *pf);
+int prefetch_async(struct prefetch *pf);
+
+void prefetch_blocks(struct prefetch *pf, int slot, const uint32_t *blocks, size_t n);
+
+#endif
@@ -0,0 +1,295 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "revmap.h"
+#include "outbuf.h"
+
+/* References recorded by one thread */
+struct entry_list {
+    struct revmap_entry *entries;
+    size_t len;
+    size_t cap;
+};
+
+struct revmap {
+    struct fs *fs;
+    struct entry_list *slots;
+    int num_slots;
+};
+
+/* Create a map filled by up to num_slots threads at a time */
+struct revmap *revmap_create(struct fs *fs, int num_slots) {
+    struct revmap *map = calloc(1, sizeof(*map));
+    if (map == NULL) {
+        return NULL;
+    }
+    map->fs = fs;
+    map->slots = calloc(num_slots, sizeof(struct entry_list));
+    map->num_slots = num_slots;
+    if (map->slots == NULL) {
+        free(map);
+        return NULL;
+    }
+    return map;
+}
+
+void revmap_destroy(struct revmap *map) {
+    if (map == NULL) {
+        return;
+    }
+    for (int i = 0; i < map->num_slots; i++) {
+        free(map->slots[i].entries);
+    }
+    free(map->slots);
+    free(map);
+}
+
+/* Record a reference from an inode to a block. No two threads may use the
+ * same slot at the same time.
+ */
+void revmap_add(struct revmap *map, int slot, uint32_t inode_id, uint32_t block_id,
+        uint64_t lbo) {
+    if (block_id == 0 || block_id >= map->fs->sb.s_blocks_count) {
+        return;
+    }
+
+    struct entry_list *list = &map->slots[slot];
+    if (list->len == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 1024;
+        struct revmap_entry *entries = realloc(list->entries, cap * sizeof(*entries));
+        if (entries == NULL) {
+            return;
+        }
+        list->entries = entries;
+        list->cap = cap;
+    }
+
+    struct revmap_entry *e = &list->entries[list->len++];
+    e->block = block_id;
+    e->inode = inode_id;
+    e->lbo = lbo;
+}
+
+static int entry_before(const struct revmap_entry *a, const struct revmap_entry *b) {
+    return a->inode < b->inode || (a->inode == b->inode && a->lbo < b->lbo);
+}
+
+/* LSD radix sort on the block number, 16 bits per pass, followed by an
+ * insertion sort of each run of entries for the same block. Such runs are
+ * rare and short, since they come from blocks shared by several inodes or
+ * referenced twice.
+ */
+static void sort_entries(struct revmap_entry *entries, struct revmap_entry *tmp, size_t n) {
+    static size_t counts[1 << 16];
+
+    for (int shift = 0; shift < 32; shift += 16) {
+        memset(counts, 0, sizeof(counts));
+        for (size_t i = 0; i < n; i++) {
+            counts[(entries[i].block >> shift) & 0xFFFF]++;
+        }
+
+        size_t pos = 0;
+        for (size_t d = 0; d < (1 << 16); d++) {
+            size_t c = counts[d];
+            counts[d] = pos;
+            pos += c;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            tmp[counts[(entries[i].block >> shift) & 0xFFFF]++] = entries[i];
+        }
+
+        struct revmap_entry *swap = entries;
+        entries = tmp;
+        tmp = swap;
+    }
+
+    for (size_t i = 1; i < n; i++) {
+        struct revmap_entry e = entries[i];
+        size_t j = i;
+        while (j > 0 && entries[j - 1].block == e.block && entry_before(&e, &entries[j - 1])) {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = e;
+    }
+}
+
+/* Sort the references into a map held in memory, which is queried like a
+ * mapped file and released with revmap_close. Must run after the scan has
+ * finished; the references are moved out of map.
+ *
+ * Return 0 on success, -1 on error
+ */
+int revmap_build(struct revmap *map, struct revmap_file *file) {
+    struct fs *fs = map->fs;
+    memset(file, 0, sizeof(*file));
+
+    size_t n = 0;
+    for (int i = 0; i < map->num_slots; i++) {
+        n += map->slots[i].len;
+    }
+
+    /* NOTE: The header and the entries share one buffer, laid out like the
+     * file
+     */
+    size_t size = sizeof(struct revmap_header) + n * sizeof(struct revmap_entry);
+    unsigned char *buf = malloc(size);
+    struct revmap_entry *tmp = malloc((n ? n : 1) * sizeof(*tmp));
+    if (buf == NULL || tmp == NULL) {
+        free(buf);
+        free(tmp);
+        return -1;
+    }
+    struct revmap_header *header = (struct revmap_header *) buf;
+    struct revmap_entry *entries = (struct revmap_entry *) (header + 1);
+
+    size_t pos = 0;
+    for (int i = 0; i < map->num_slots; i++) {
+        struct entry_list *list = &map->slots[i];
+        if (list->len > 0) {
+            memcpy(entries + pos, list->entries, list->len * sizeof(*entries));
+            pos += list->len;
+        }
+        free(list->entries);
+        list->entries = NULL;
+        list->len = list->cap = 0;
+    }
+
+    /* NOTE: Two passes leave the sorted entries back in the first buffer */
+    sort_entries(entries, tmp, n);
+    free(tmp);
+
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, REVMAP_MAGIC, sizeof(header->magic));
+    header->version = REVMAP_VERSION;
+    header->block_size = fs->block_size;
+    header->blocks_count = fs->sb.s_blocks_count;
+    header->num_entries = n;
+
+    file->map = buf;
+    file->size = size;
+    file->header = header;
+    file->entries = entries;
+    file->in_memory = 1;
+    return 0;
+}
+
+/* Sort the references and write them to path. Must run after the scan has
+ * finished.
+ *
+ * Return 0 on success, -1 on error
+ */
+int revmap_write(struct revmap *map, const char *path) {
+    struct revmap_file file;
+    if (revmap_build(map, &file) == -1) {
+        return -1;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        revmap_close(&file);
+        return -1;
+    }
+
+    struct outbuf whole;
+    struct outbuf *parts[1] = {&whole};
+    outbuf_init(&whole, -1, 0);
+    whole.buf = (char *) file.map;
+    whole.len = file.size;
+    int rc = outbuf_writev(fd, parts, 1);
+    revmap_close(&file);
+
+    if (close(fd) == -1) {
+        rc = -1;
+    }
+    return rc;
+}
+
+/* Map a reverse map file and check its header.
+ *
+ * Return 0 on success, -1 on error
+ */
+int revmap_open(struct revmap_file *file, const char *path) {
+    memset(file, 0, sizeof(*file));
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t) st.st_size < sizeof(struct revmap_header)) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    file->map = map;
+    file->size = st.st_size;
+    file->header = map;
+    file->entries = (const struct revmap_entry *) (file->header + 1);
+
+    const struct revmap_header *header = file->header;
+    size_t data_size = file->size - sizeof(*header);
+    if (memcmp(header->magic, REVMAP_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != REVMAP_VERSION ||
+            header->num_entries != data_size / sizeof(struct revmap_entry) ||
+            data_size % sizeof(struct revmap_entry) != 0) {
+        revmap_close(file);
+        return -1;
+    }
+
+    /* NOTE: Lookups touch a handful of pages scattered over the file */
+    madvise(map, file->size, MADV_RANDOM);
+
+    return 0;
+}
+
+void revmap_close(struct revmap_file *file) {
+    if (file->in_memory) {
+        free((void *) file->map);
+    } else if (file->map) {
+        munmap((void *) file->map, file->size);
+    }
+    memset(file, 0, sizeof(*file));
+}
+
+/* Return the first entry for a block and store the number of entries for
+ * it in count
+ */
+const struct revmap_entry *revmap_find(const struct revmap_file *file, uint32_t block_id,
+        size_t *count) {
+    const struct revmap_entry *entries = file->entries;
+    size_t lo = 0;
+    size_t hi = file->header->num_entries;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (entries[mid].block < block_id) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    size_t end = lo;
+    while (end < file->header->num_entries && entries[end].block == block_id) {
+        end++;
+    }
+
+    *count = end - lo;
+    return entries + lo;
+}
@@ -0,0 +1,65 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef REVMAP_H
+#define REVMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fs.h"
+
+/* Block ownership reverse map (--revmap).
+ *
+ * The file is a header followed by one entry per block reference, sorted
+ * by block number, then inode and logical offset. Indirect blocks are
+ * listed with the logical offset of the first data block they cover, like
+ * INDIRECT records. All fields are little-endian and the entries are
+ * naturally aligned, so the file can be mapped and searched in place.
+ */
+
+#define REVMAP_MAGIC "EXT2RMAP"
+#define REVMAP_VERSION 1
+
+struct revmap_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t blocks_count;
+    uint32_t reserved;
+    uint64_t num_entries;
+};
+
+struct revmap_entry {
+    uint32_t block;
+    uint32_t inode;
+    uint64_t lbo;
+};
+
+/* Building a map during the scan */
+struct revmap;
+struct revmap_file;
+
+struct revmap *revmap_create(struct fs *fs, int num_slots);
+void revmap_destroy(struct revmap *map);
+void revmap_add(struct revmap *map, int slot, uint32_t inode_id, uint32_t block_id,
+        uint64_t lbo);
+int revmap_build(struct revmap *map, struct revmap_file *file);
+int revmap_write(struct revmap *map, const char *path);
+
+/* Querying a map file, or a map built in memory */
+struct revmap_file {
+    const unsigned char *map;
+    size_t size;
+    const struct revmap_header *header;
+    const struct revmap_entry *entries;
+    int in_memory;              /* Built by revmap_build rather than mapped */
+};
+
+int revmap_open(struct revmap_file *file, const char *path);
+void revmap_close(struct revmap_file *file);
+const struct revmap_entry *revmap_find(const struct revmap_file *file, uint32_t block_id,
+        size_t *count);
+
+#endif
@@ -0,0 +1,160 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "scheduler.h"
+
+struct task {
+    task_fn fn;
+    void *arg;
+};
+
+/* Ring buffer of tasks. The owner pushes and pops at the tail, thieves
+ * take from the head.
+ */
+struct deque {
+    pthread_mutex_t lock;
+    struct task *tasks;
+    size_t head;
+    size_t len;
+    size_t cap;
+};
+
+struct sched {
+    struct deque *deques;
+    int num_workers;
+    int next_submit;            /* Deque receiving the next submitted task */
+    atomic_size_t pending;      /* Tasks spawned but not finished yet */
+};
+
+struct sched *sched_create(int num_workers) {
+    struct sched *sched = calloc(1, sizeof(*sched));
+    if (sched == NULL) {
+        return NULL;
+    }
+
+    if (num_workers < 1) {
+        num_workers = 1;
+    }
+    sched->deques = calloc(num_workers, sizeof(struct deque));
+    if (sched->deques == NULL) {
+        free(sched);
+        return NULL;
+    }
+    sched->num_workers = num_workers;
+    for (int w = 0; w < num_workers; w++) {
+        pthread_mutex_init(&sched->deques[w].lock, NULL);
+    }
+
+    return sched;
+}
+
+void sched_destroy(struct sched *sched) {
+    if (sched == NULL) {
+        return;
+    }
+    for (int w = 0; w < sched->num_workers; w++) {
+        pthread_mutex_destroy(&sched->deques[w].lock);
+        free(sched->deques[w].tasks);
+    }
+    free(sched->deques);
+    free(sched);
+}
+
+int sched_workers(struct sched *sched) {
+    return sched->num_workers;
+}
+
+static void push(struct deque *dq, task_fn fn, void *arg) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->len == dq->cap) {
+        size_t cap = dq->cap ? dq->cap * 2 : 64;
+        struct task *tasks = malloc(cap * sizeof(*tasks));
+        if (tasks == NULL) {
+            fprintf(stderr, "Unable to allocate task queue!\n");
+            exit(2);
+        }
+        for (size_t i = 0; i < dq->len; i++) {
+            tasks[i] = dq->tasks[(dq->head + i) % dq->cap];
+        }
+        free(dq->tasks);
+        dq->tasks = tasks;
+        dq->head = 0;
+        dq->cap = cap;
+    }
+    struct task *t = &dq->tasks[(dq->head + dq->len) % dq->cap];
+    t->fn = fn;
+    t->arg = arg;
+    dq->len++;
+    pthread_mutex_unlock(&dq->lock);
+}
+
+/* Take the newest task of a deque (own == 1) or the oldest one.
+ *
+ * Return 1 if a task was taken, 0 if the deque was empty
+ */
+static int take(struct deque *dq, int own, struct task *t) {
+    int found = 0;
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->len > 0) {
+        if (own) {
+            *t = dq->tasks[(dq->head + dq->len - 1) % dq->cap];
+        } else {
+            *t = dq->tasks[dq->head];
+            dq->head = (dq->head + 1) % dq->cap;
+        }
+        dq->len--;
+        found = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+
+    return found;
+}
+
+/* Queue a task before sched_run. Tasks are dealt out over the workers. */
+void sched_submit(struct sched *sched, task_fn fn, void *arg) {
+    atomic_fetch_add(&sched->pending, 1);
+    push(&sched->deques[sched->next_submit], fn, arg);
+    sched->next_submit = (sched->next_submit + 1) % sched->num_workers;
+}
+
+/* Queue a task from within a task running on worker */
+void sched_spawn(struct sched *sched, int worker, task_fn fn, void *arg) {
+    atomic_fetch_add(&sched->pending, 1);
+    push(&sched->deques[worker], fn, arg);
+}
+
+static void run_worker(void *arg, size_t worker) {
+    struct sched *sched = arg;
+    int w = worker;
+    struct task t;
+
+    for (;;) {
+        int found = take(&sched->deques[w], 1, &t);
+        for (int i = 1; !found && i < sched->num_workers; i++) {
+            found = take(&sched->deques[(w + i) % sched->num_workers], 0, &t);
+        }
+
+        if (found) {
+            t.fn(sched, w, t.arg);
+            atomic_fetch_sub(&sched->pending, 1);
+        } else if (atomic_load(&sched->pending) == 0) {
+            break;
+        } else {
+            /* NOTE: Running tasks may still spawn more work */
+            sched_yield();
+        }
+    }
+}
+
+/* Run every queued task to completion on the threads of pool */
+void sched_run(struct sched *sched, struct pool *pool) {
+    pool_for(pool, sched->num_workers, run_worker, sched);
+}
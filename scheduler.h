@@ -0,0 +1,36 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "pool.h"
+
+/* Work-stealing task scheduler running on the threads of a pool.
+ *
+ * Every worker owns a deque of tasks. A worker pushes the tasks it spawns
+ * onto its own deque and pops the newest one first, so a task tree is
+ * walked depth-first on one thread. A worker that runs dry steals the
+ * oldest task of another worker, which tends to be the largest piece of
+ * work left. sched_run returns once every task, including the ones
+ * spawned while it runs, has finished.
+ */
+
+struct sched;
+
+/* worker is the index of the worker running the task, for sched_spawn and
+ * for per-worker state of the caller
+ */
+typedef void (*task_fn)(struct sched *sched, int worker, void *arg);
+
+struct sched *sched_create(int num_workers);
+void sched_destroy(struct sched *sched);
+int sched_workers(struct sched *sched);
+
+void sched_submit(struct sched *sched, task_fn fn, void *arg);
+void sched_spawn(struct sched *sched, int worker, task_fn fn, void *arg);
+void sched_run(struct sched *sched, struct pool *pool);
+
+#endif
@@ -0,0 +1,296 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "serve.h"
+
+#define SERVE_MAX_CLIENTS 64
+#define SERVE_COPY_SIZE (64 * 1024)
+
+/* A connection and its partly received requests */
+struct client {
+    int fd;
+    size_t len;
+    char buf[sizeof(uint32_t) + SERVE_MAX_REQUEST + 1];
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int sig) {
+    (void) sig;
+    stopping = 1;
+}
+
+static int socket_address(const char *path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Send a header and its payload with a single writev where possible */
+static int send_frame(int fd, const void *header, size_t header_len, const char *data,
+        size_t len) {
+    struct outbuf parts[2];
+    struct outbuf *order[2] = {&parts[0], &parts[1]};
+    outbuf_init(&parts[0], -1, 0);
+    outbuf_init(&parts[1], -1, 0);
+    parts[0].buf = (char *) header;
+    parts[0].len = header_len;
+    parts[1].buf = (char *) data;
+    parts[1].len = len;
+    return outbuf_writev(fd, order, 2);
+}
+
+/* Answer every complete request received from a client.
+ *
+ * Return 0 on success, -1 if the client has to be dropped
+ */
+static int answer_client(struct client *c, serve_fn fn, void *arg, struct outbuf *out) {
+    for (;;) {
+        uint32_t len;
+        if (c->len < sizeof(len)) {
+            return 0;
+        }
+        memcpy(&len, c->buf, sizeof(len));
+
+        struct serve_reply reply;
+        if (len > SERVE_MAX_REQUEST) {
+            reply.status = SERVE_BAD_REQUEST;
+            reply.len = 0;
+            send_frame(c->fd, &reply, sizeof(reply), NULL, 0);
+            return -1;
+        }
+        size_t frame_len = sizeof(len) + len;
+        if (c->len < frame_len) {
+            return 0;
+        }
+
+        /* NOTE: The byte after the request may start the next one */
+        char *request = c->buf + sizeof(len);
+        char next = request[len];
+        request[len] = '\0';
+        out->len = 0;
+        reply.status = fn(arg, request, out);
+        request[len] = next;
+        if (out->error) {
+            reply.status = SERVE_ERROR;
+            out->len = 0;
+            out->error = 0;
+        }
+
+        reply.len = out->len;
+        if (send_frame(c->fd, &reply, sizeof(reply), out->buf, out->len) == -1) {
+            return -1;
+        }
+
+        memmove(c->buf, c->buf + frame_len, c->len - frame_len);
+        c->len -= frame_len;
+    }
+}
+
+/* Listen on the socket at path and answer requests with fn until SIGINT or
+ * SIGTERM. Requests are answered one at a time, so fn needs no locking.
+ *
+ * Return 0 on success, -1 on error
+ */
+int serve_run(const char *path, serve_fn fn, void *arg) {
+    struct sockaddr_un addr;
+    if (socket_address(path, &addr) == -1) {
+        return -1;
+    }
+
+    /* NOTE: A socket left behind by an earlier daemon is replaced, any
+     * other file is not
+     */
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(path);
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        return -1;
+    }
+    if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 ||
+            listen(listen_fd, SOMAXCONN) == -1) {
+        close(listen_fd);
+        return -1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    struct client *clients = calloc(SERVE_MAX_CLIENTS, sizeof(*clients));
+    struct pollfd fds[SERVE_MAX_CLIENTS + 1];
+    int num_clients = 0;
+    int rc = 0;
+    if (clients == NULL) {
+        close(listen_fd);
+        unlink(path);
+        return -1;
+    }
+
+    struct outbuf out;
+    outbuf_init(&out, -1, 0);
+
+    while (!stopping) {
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < num_clients; i++) {
+            fds[i + 1].fd = clients[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+
+        if (poll(fds, num_clients + 1, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            rc = -1;
+            break;
+        }
+
+        for (int i = 0; i < num_clients; i++) {
+            struct client *c = &clients[i];
+            if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            ssize_t n = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+            if (n == -1 && errno == EINTR) {
+                continue;
+            }
+            if (n > 0) {
+                c->len += n;
+            }
+            if (n <= 0 || answer_client(c, fn, arg, &out) == -1) {
+                close(c->fd);
+                c->fd = -1;
+            }
+        }
+
+        /* Drop closed connections, keeping the others in order */
+        int kept = 0;
+        for (int i = 0; i < num_clients; i++) {
+            if (clients[i].fd != -1) {
+                if (kept != i) {
+                    memcpy(&clients[kept], &clients[i], sizeof(clients[i]));
+                }
+                kept++;
+            }
+        }
+        num_clients = kept;
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd != -1 && num_clients == SERVE_MAX_CLIENTS) {
+                close(fd);
+            } else if (fd != -1) {
+                clients[num_clients].fd = fd;
+                clients[num_clients].len = 0;
+                num_clients++;
+            }
+        }
+    }
+
+    for (int i = 0; i < num_clients; i++) {
+        close(clients[i].fd);
+    }
+    free(clients);
+    outbuf_free(&out);
+    close(listen_fd);
+    unlink(path);
+    return rc;
+}
+
+/* Send requests to the daemon at path and copy the records of the replies
+ * to out_fd. The status of every request is stored in statuses.
+ *
+ * Return 0 on success, -1 on error
+ */
+int serve_query(const char *path, char **requests, int num_requests, uint32_t *statuses,
+        int out_fd) {
+    struct sockaddr_un addr;
+    if (socket_address(path, &addr) == -1) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    char *copy = malloc(SERVE_COPY_SIZE);
+    if (copy == NULL || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        free(copy);
+        close(fd);
+        return -1;
+    }
+
+    struct outbuf out;
+    outbuf_init(&out, out_fd, 0);
+
+    int rc = 0;
+    for (int i = 0; i < num_requests && rc == 0; i++) {
+        uint32_t len = strlen(requests[i]);
+        struct serve_reply reply;
+        if (send_frame(fd, &len, sizeof(len), requests[i], len) == -1 ||
+                read_all(fd, &reply, sizeof(reply)) == -1) {
+            rc = -1;
+            break;
+        }
+        statuses[i] = reply.status;
+
+        /* NOTE: Replies can be large, so they are copied piece by piece */
+        while (reply.len > 0) {
+            size_t n = reply.len < SERVE_COPY_SIZE ? reply.len : SERVE_COPY_SIZE;
+            if (read_all(fd, copy, n) == -1) {
+                rc = -1;
+                break;
+            }
+            out.buf = copy;
+            out.len = n;
+            if (outbuf_flush(&out) == -1) {
+                rc = -1;
+                break;
+            }
+            reply.len -= n;
+        }
+    }
+
+    free(copy);
+    close(fd);
+    return rc;
+}
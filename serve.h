@@ -0,0 +1,41 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdint.h>
+#include "outbuf.h"
+
+/* Query daemon on a Unix socket (--serve) and its client (--query).
+ *
+ * A request is a 32-bit length followed by that many bytes of text, such
+ * as "INODE 12". A reply is a serve_reply header followed by len bytes of
+ * records in the usual CSV format. All integers are little-endian. A
+ * connection may carry any number of requests, which are answered in
+ * order.
+ */
+
+#define SERVE_MAX_REQUEST 4096
+
+/* Reply status */
+#define SERVE_OK 0
+#define SERVE_NOT_FOUND 1       /* No such inode, directory or group */
+#define SERVE_BAD_REQUEST 2
+#define SERVE_ERROR 3
+
+struct serve_reply {
+    uint32_t status;
+    uint32_t len;
+};
+
+/* Answer a NUL-terminated request into reply and return its status */
+typedef uint32_t (*serve_fn)(void *arg, char *request, struct outbuf *reply);
+
+int serve_run(const char *path, serve_fn fn, void *arg);
+int serve_query(const char *path, char **requests, int num_requests, uint32_t *statuses,
+        int out_fd);
+
+#endif
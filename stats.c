@@ -0,0 +1,164 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "stats.h"
+
+static void sample(struct stats *stats, struct stats_sample *s) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    s->time_ms = ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    s->major_faults = ru.ru_majflt;
+
+    s->reads = 0;
+    s->read_bytes = 0;
+    s->cache_hits = 0;
+    s->cache_misses = 0;
+    if (stats->img) {
+        struct cache_stats cs;
+        image_cache_stats(stats->img, &cs);
+        s->reads = __atomic_load_n(&stats->img->reads, __ATOMIC_RELAXED);
+        s->read_bytes = __atomic_load_n(&stats->img->read_bytes, __ATOMIC_RELAXED);
+        s->cache_hits = cs.hits;
+        s->cache_misses = cs.misses;
+    }
+}
+
+static void subtract(struct stats_sample *d, const struct stats_sample *a,
+        const struct stats_sample *b) {
+    d->time_ms = a->time_ms - b->time_ms;
+    d->reads = a->reads - b->reads;
+    d->read_bytes = a->read_bytes - b->read_bytes;
+    d->cache_hits = a->cache_hits - b->cache_hits;
+    d->cache_misses = a->cache_misses - b->cache_misses;
+    d->major_faults = a->major_faults - b->major_faults;
+}
+
+void stats_init(struct stats *stats, int num_threads) {
+    memset(stats, 0, sizeof(*stats));
+    stats->num_threads = num_threads;
+    sample(stats, &stats->start);
+    stats->phase_start = stats->start;
+}
+
+/* Start counting the reads of an image. Its counters start at zero, so
+ * this may happen in the middle of a phase.
+ */
+void stats_attach(struct stats *stats, struct image *img) {
+    if (stats == NULL) {
+        return;
+    }
+    stats->img = img;
+}
+
+void stats_begin(struct stats *stats) {
+    if (stats == NULL) {
+        return;
+    }
+    sample(stats, &stats->phase_start);
+}
+
+void stats_end(struct stats *stats, const char *name) {
+    if (stats == NULL || stats->num_phases == STATS_MAX_PHASES) {
+        return;
+    }
+
+    struct stats_sample now;
+    sample(stats, &now);
+
+    struct stats_phase *phase = &stats->phases[stats->num_phases++];
+    phase->name = name;
+    subtract(&phase->delta, &now, &stats->phase_start);
+}
+
+/* Add count records of one type */
+void stats_add_records(struct stats *stats, const char *name, uint64_t count) {
+    if (stats == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < stats->num_records; i++) {
+        if (strcmp(stats->records[i].name, name) == 0) {
+            stats->records[i].count += count;
+            return;
+        }
+    }
+
+    if (stats->num_records < STATS_MAX_RECORDS) {
+        struct stats_records *r = &stats->records[stats->num_records++];
+        r->name = name;
+        r->count = count;
+    }
+}
+
+static void write_sample(FILE *f, const struct stats_sample *s) {
+    fprintf(f, "\"wall_ms\": %.3f, \"preads\": %llu, \"pread_bytes\": %llu, "
+            "\"cache_hits\": %llu, \"cache_misses\": %llu, \"major_faults\": %llu",
+            s->time_ms, (unsigned long long) s->reads, (unsigned long long) s->read_bytes,
+            (unsigned long long) s->cache_hits, (unsigned long long) s->cache_misses,
+            (unsigned long long) s->major_faults);
+}
+
+/* Write the report to path, or to stderr if path is NULL.
+ *
+ * Return 0 on success, -1 on error
+ */
+int stats_write(struct stats *stats, const char *path) {
+    if (stats == NULL) {
+        return 0;
+    }
+
+    FILE *f = stderr;
+    if (path) {
+        f = fopen(path, "w");
+        if (f == NULL) {
+            return -1;
+        }
+    }
+
+    struct stats_sample now;
+    struct stats_sample total;
+    sample(stats, &now);
+    subtract(&total, &now, &stats->start);
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+
+    struct image *img = stats->img;
+    fprintf(f, "{\n  \"threads\": %d,\n  \"peak_rss_kb\": %ld,\n", stats->num_threads,
+            ru.ru_maxrss);
+    if (img) {
+        fprintf(f, "  \"mmap\": %s,\n  \"block_size\": %d,\n  \"image_bytes\": %lld,\n",
+                img->map ? "true" : "false", img->block_size, (long long) img->size);
+    }
+
+    fprintf(f, "  \"total\": {");
+    write_sample(f, &total);
+    fprintf(f, "},\n  \"phases\": [");
+    for (int i = 0; i < stats->num_phases; i++) {
+        fprintf(f, "%s\n    {\"name\": \"%s\", ", i ? "," : "", stats->phases[i].name);
+        write_sample(f, &stats->phases[i].delta);
+        fprintf(f, "}");
+    }
+    fprintf(f, "\n  ],\n  \"records\": {");
+    for (int i = 0; i < stats->num_records; i++) {
+        const struct stats_records *r = &stats->records[i];
+        fprintf(f, "%s\n    \"%s\": %llu", i ? "," : "", r->name,
+                (unsigned long long) r->count);
+    }
+    fprintf(f, "\n  }\n}\n");
+
+    int rc = ferror(f) ? -1 : 0;
+    if (path && fclose(f) == EOF) {
+        rc = -1;
+    }
+    return rc;
+}
@@ -0,0 +1,64 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include "image.h"
+
+/* Per-phase instrumentation (--stats).
+ *
+ * stats_begin and stats_end bracket a phase of main and record its wall
+ * time along with the preads, cache hits and misses and major page faults
+ * it caused. Record counts are added by the caller. stats_write prints the
+ * whole report, with the peak RSS of the run, as a JSON document.
+ *
+ * Every function accepts a NULL stats and does nothing, so the
+ * instrumentation costs a branch per phase when disabled.
+ */
+
+#define STATS_MAX_PHASES 16
+#define STATS_MAX_RECORDS 16
+
+/* Counters sampled at the start and end of a phase */
+struct stats_sample {
+    double time_ms;
+    uint64_t reads;
+    uint64_t read_bytes;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t major_faults;
+};
+
+struct stats_phase {
+    const char *name;
+    struct stats_sample delta;
+};
+
+struct stats_records {
+    const char *name;
+    uint64_t count;
+};
+
+struct stats {
+    struct image *img;      /* NULL until the image is open */
+    int num_threads;
+    struct stats_sample start;
+    struct stats_sample phase_start;
+    struct stats_phase phases[STATS_MAX_PHASES];
+    int num_phases;
+    struct stats_records records[STATS_MAX_RECORDS];
+    int num_records;
+};
+
+void stats_init(struct stats *stats, int num_threads);
+void stats_attach(struct stats *stats, struct image *img);
+void stats_begin(struct stats *stats);
+void stats_end(struct stats *stats, const char *name);
+void stats_add_records(struct stats *stats, const char *name, uint64_t count);
+int stats_write(struct stats *stats, const char *path);
+
+#endif
@@ -0,0 +1,80 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#include <string.h>
+#include "timefmt.h"
+
+/* NOTE: ctime, mtime and atime of an inode are frequently identical, and
+ * neighbouring inodes often share them too. Each thread remembers the last
+ * few timestamps it formatted, so no locking is needed.
+ */
+#define TIMEFMT_CACHE_SIZE 4
+
+struct timefmt_entry {
+    uint32_t t;
+    int valid;
+    char text[TIMEFMT_LEN + 1];
+};
+
+static __thread struct timefmt_entry cache[TIMEFMT_CACHE_SIZE];
+static __thread unsigned cache_next;
+
+static inline void put2(char *p, unsigned v) {
+    p[0] = '0' + v / 10;
+    p[1] = '0' + v % 10;
+}
+
+/* Convert days since 1970-01-01 to a civil date (proleptic Gregorian).
+ * See http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+ */
+static void civil_from_days(int64_t z, int64_t *year, unsigned *month, unsigned *day) {
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned) (z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = (int64_t) yoe + era * 400 + (*month <= 2);
+}
+
+/* Format t (seconds since the epoch) as "mm/dd/yy hh:mm:ss" in GMT. This
+ * matches strftime("%x %X") in the C locale without touching the locale or
+ * any static storage, so it is safe to call from any thread.
+ */
+void format_gmt(uint32_t t, char buf[TIMEFMT_LEN + 1]) {
+    for (int i = 0; i < TIMEFMT_CACHE_SIZE; i++) {
+        if (cache[i].valid && cache[i].t == t) {
+            memcpy(buf, cache[i].text, TIMEFMT_LEN + 1);
+            return;
+        }
+    }
+
+    int64_t days = t / 86400;
+    unsigned secs = t % 86400;
+    int64_t year;
+    unsigned month, day;
+    civil_from_days(days, &year, &month, &day);
+
+    put2(buf, month);
+    buf[2] = '/';
+    put2(buf + 3, day);
+    buf[5] = '/';
+    put2(buf + 6, (unsigned) (year % 100));
+    buf[8] = ' ';
+    put2(buf + 9, secs / 3600);
+    buf[11] = ':';
+    put2(buf + 12, secs / 60 % 60);
+    buf[14] = ':';
+    put2(buf + 15, secs % 60);
+    buf[TIMEFMT_LEN] = '\0';
+
+    struct timefmt_entry *e = &cache[cache_next++ % TIMEFMT_CACHE_SIZE];
+    e->t = t;
+    e->valid = 1;
+    memcpy(e->text, buf, TIMEFMT_LEN + 1);
+}
@@ -0,0 +1,16 @@
+/* NAME: Jesse Catalan,Ricardo Kuchimpos
+ * EMAIL: jessecatalan77@gmail.com,rkuchimpos@gmail.com
+ * ID: 204785152,704827423
+ */
+
+#ifndef TIMEFMT_H
+#define TIMEFMT_H
+
+#include <stdint.h>
+
+/* Length of "mm/dd/yy hh:mm:ss" without the terminating NUL */
+#define TIMEFMT_LEN 17
+
+void format_gmt(uint32_t t, char buf[TIMEFMT_LEN + 1]);
+
+#endif